@@ -0,0 +1,232 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// times the frames of the two renderers of View on the same synthetic strip, rendered offscreen:
+// renderbenchmark [pages [frames]]
+// scene: a QGraphicsView with one item per page, like View with the scene renderer;
+// strip: the pages found through PageLayout blitted in the viewport's paint event, like View::paintStrip
+
+#include <QAbstractScrollArea>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QImage>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <QStyleOptionGraphicsItem>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "pagelayout.h"
+
+namespace
+{
+
+const QSize ViewportSize(1280, 900);
+constexpr int PageSpacing = 10;
+// pages of a few sizes share their images, View's cache holds one image per page
+constexpr int DistinctImages = 8;
+
+// what Page::paintImage draws: a border and the exposed part of the image, at 0,0
+void paintImage(QPainter *painter, const QImage &image, const QRectF &exposedRect)
+{
+    QRectF border(QPointF(0, 0), QSizeF(image.size()));
+    border.adjust(-1, -1, 1, 1);
+    painter->setPen(QPen(Qt::black));
+    painter->drawRect(border);
+    painter->setPen(QPen());
+    const QRectF rect = exposedRect.intersected(QRectF(QPointF(0, 0), QSizeF(image.size())));
+    painter->drawImage(rect, image, rect);
+}
+
+class PageItem : public QGraphicsItem
+{
+public:
+    explicit PageItem(const QImage *image)
+        : m_image{image}
+    {
+    }
+
+    auto boundingRect() const -> QRectF override
+    {
+        return {QPointF(0, 0), QSizeF(m_image->size())};
+    }
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override
+    {
+        Q_UNUSED(widget)
+        paintImage(painter, *m_image, option->exposedRect);
+    }
+
+private:
+    const QImage *m_image;
+};
+
+class SceneView : public QGraphicsView
+{
+public:
+    SceneView(const std::vector<const QImage *> &pages, const PageLayout &layout)
+    {
+        setFrameShape(QFrame::NoFrame);
+        setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing);
+        setBackgroundBrush(Qt::darkGray);
+        setCacheMode(QGraphicsView::CacheBackground);
+        auto scene = new QGraphicsScene(this);
+        for (size_t i = 0; i < pages.size(); ++i) {
+            auto item = new PageItem(pages[i]);
+            item->setPos((ViewportSize.width() - pages[i]->width()) / 2, layout.start(static_cast<int>(i)));
+            scene->addItem(item);
+        }
+        scene->setSceneRect((ViewportSize.width() - layout.maxWidth()) / 2, 0, layout.maxWidth(), layout.height());
+        setScene(scene);
+    }
+};
+
+class StripView : public QAbstractScrollArea
+{
+public:
+    StripView(const std::vector<const QImage *> &pages, const PageLayout &layout)
+        : m_pages{pages}
+        , m_layout{layout}
+    {
+        setFrameShape(QFrame::NoFrame);
+    }
+
+protected:
+    void resizeEvent(QResizeEvent *event) override
+    {
+        QAbstractScrollArea::resizeEvent(event);
+        verticalScrollBar()->setRange(0, std::max(0, m_layout.height() - viewport()->height()));
+        verticalScrollBar()->setPageStep(viewport()->height());
+    }
+
+    void paintEvent(QPaintEvent *event) override
+    {
+        QPainter painter(viewport());
+        painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing);
+        painter.fillRect(event->rect(), Qt::darkGray);
+
+        const int offset = verticalScrollBar()->value();
+        const QRectF exposed = QRectF(event->rect()).translated(0, offset);
+        const int count = static_cast<int>(m_pages.size());
+        for (int i = m_layout.pageAt(static_cast<int>(exposed.top())); i < count && m_layout.start(i) < exposed.bottom(); i++) {
+            const QImage &image = *m_pages[i];
+            const QPointF topLeft((viewport()->width() - image.width()) / 2, m_layout.start(i));
+            painter.save();
+            painter.translate(topLeft - QPointF(0, offset));
+            paintImage(&painter, image, exposed.translated(-topLeft));
+            painter.restore();
+        }
+    }
+
+private:
+    const std::vector<const QImage *> &m_pages;
+    const PageLayout &m_layout;
+};
+
+auto randomImage(const QSize &size) -> QImage
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < image.height(); ++y) {
+        QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(image.scanLine(y)),
+                                              image.bytesPerLine() / sizeof(quint32));
+    }
+    return image;
+}
+
+struct FrameTimes {
+    double average;
+    double median;
+    double worst;
+};
+
+// renders the viewport at frames scroll positions spread over the whole strip
+auto renderFrames(QAbstractScrollArea *view, int frames) -> FrameTimes
+{
+    QImage target(ViewportSize, QImage::Format_ARGB32_Premultiplied);
+    QScrollBar *scrollBar = view->verticalScrollBar();
+    // warms up the caches, the first frame isn't counted
+    view->viewport()->render(&target);
+
+    std::vector<double> times;
+    times.reserve(frames);
+    QElapsedTimer timer;
+    for (int i = 0; i < frames; ++i) {
+        scrollBar->setValue(static_cast<int>(static_cast<qint64>(scrollBar->maximum()) * i / std::max(1, frames - 1)));
+        timer.start();
+        view->viewport()->render(&target);
+        times.push_back(static_cast<double>(timer.nsecsElapsed()) / 1e6);
+    }
+    double total = 0;
+    for (double time : times) {
+        total += time;
+    }
+    std::sort(times.begin(), times.end());
+    return {total / frames, times[times.size() / 2], times.back()};
+}
+
+} // namespace
+
+auto main(int argc, char *argv[]) -> int
+{
+    // nothing is shown, the frames are rendered into images
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    int pageCount = 300;
+    int frames = 200;
+    if (argc >= 2) {
+        pageCount = QString::fromLocal8Bit(argv[1]).toInt();
+    }
+    if (argc >= 3) {
+        frames = QString::fromLocal8Bit(argv[2]).toInt();
+    }
+    if (pageCount <= 0 || frames <= 0) {
+        std::fprintf(stderr, "usage: %s [pages [frames]]\n", argv[0]);
+        return 1;
+    }
+
+    // pages scaled to the viewport width or narrower, like fit width with a maximum width
+    std::vector<QImage> images;
+    for (int i = 0; i < DistinctImages; ++i) {
+        const int width = ViewportSize.width() - 80 * (i % 4);
+        images.push_back(randomImage(QSize(width, width * (14 + i % 3) / 10)));
+    }
+    std::vector<const QImage *> pages(pageCount);
+    std::vector<QSize> sizes(pageCount);
+    for (int i = 0; i < pageCount; ++i) {
+        pages[i] = &images[i % DistinctImages];
+        sizes[i] = pages[i]->size();
+    }
+    PageLayout layout;
+    layout.setSizes(sizes, PageSpacing);
+
+    // shown on the offscreen platform so the viewports and scroll ranges get their size
+    SceneView scene(pages, layout);
+    scene.resize(ViewportSize);
+    scene.show();
+    StripView strip(pages, layout);
+    strip.resize(ViewportSize);
+    strip.show();
+    QCoreApplication::processEvents();
+
+    std::printf("%d pages, %d frames of %dx%d\n", pageCount, frames, ViewportSize.width(), ViewportSize.height());
+    std::printf("%-10s %12s %12s %12s\n", "renderer", "average ms", "median ms", "worst ms");
+    const FrameTimes sceneTimes = renderFrames(&scene, frames);
+    std::printf("%-10s %12.3f %12.3f %12.3f\n", "scene", sceneTimes.average, sceneTimes.median, sceneTimes.worst);
+    const FrameTimes stripTimes = renderFrames(&strip, frames);
+    std::printf("%-10s %12.3f %12.3f %12.3f\n", "strip", stripTimes.average, stripTimes.median, stripTimes.worst);
+    return 0;
+}
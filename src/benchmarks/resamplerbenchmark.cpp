@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// times Resampler::scaled against QImage::scaled for typical page sizes:
+// resamplerbenchmark [width height [iterations]]
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QStringList>
+
+#include <cstdio>
+
+#include "resampler.h"
+
+namespace
+{
+
+auto randomImage(const QSize &size, QImage::Format format) -> QImage
+{
+    QImage image(size, format);
+    for (int y = 0; y < image.height(); ++y) {
+        QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(image.scanLine(y)),
+                                              image.bytesPerLine() / sizeof(quint32));
+    }
+    return image;
+}
+
+template<typename F>
+auto milliseconds(int iterations, F scale) -> double
+{
+    scale();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        scale();
+    }
+    return static_cast<double>(timer.nsecsElapsed()) / 1e6 / iterations;
+}
+
+} // namespace
+
+auto main(int argc, char *argv[]) -> int
+{
+    QSize source(1800, 2600);
+    int iterations = 20;
+    if (argc >= 3) {
+        source = QSize(QString::fromLocal8Bit(argv[1]).toInt(), QString::fromLocal8Bit(argv[2]).toInt());
+    }
+    if (argc >= 4) {
+        iterations = QString::fromLocal8Bit(argv[3]).toInt();
+    }
+    if (source.isEmpty() || iterations <= 0) {
+        std::fprintf(stderr, "usage: %s [width height [iterations]]\n", argv[0]);
+        return 1;
+    }
+
+    const QList<QSize> targets{source / 2, source * 2 / 3, source / 3};
+    const QList<QImage::Format> formats{QImage::Format_ARGB32_Premultiplied, QImage::Format_Grayscale8};
+    const QStringList filterNames{QStringLiteral("box"), QStringLiteral("bilinear"), QStringLiteral("lanczos3")};
+
+    std::printf("%-10s %-12s %-10s %12s %12s\n", "format", "size", "filter", "resampler ms", "qt smooth ms");
+    for (QImage::Format format : formats) {
+        const QImage image = randomImage(source, format);
+        for (const QSize &target : targets) {
+            const double qt = milliseconds(iterations, [&] {
+                return image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            });
+            for (int filter = 0; filter < filterNames.count(); ++filter) {
+                const double ours = milliseconds(iterations, [&] {
+                    return Resampler::scaled(image, target, static_cast<Resampler::Filter>(filter));
+                });
+                std::printf("%-10s %-12s %-10s %12.2f %12.2f\n",
+                            format == QImage::Format_Grayscale8 ? "gray8" : "argb32",
+                            qPrintable(QStringLiteral("%1x%2").arg(target.width()).arg(target.height())),
+                            qPrintable(filterNames.at(filter)), ours, qt);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "comicinfo.h"
+
+#include <QXmlStreamReader>
+
+namespace ComicInfo
+{
+
+auto applyPages(const QByteArray &xml, QStringList *files) -> std::vector<QSize>
+{
+    // Image is the index of the page in the sorted images of the archive
+    std::vector<int> order;
+    std::vector<QSize> sizes;
+    QXmlStreamReader reader(xml);
+    while (reader.readNextStartElement()) {
+        if (reader.name() == u"ComicInfo") {
+            continue;
+        }
+        if (reader.name() != u"Pages") {
+            reader.skipCurrentElement();
+            continue;
+        }
+        while (reader.readNextStartElement()) {
+            if (reader.name() == u"Page") {
+                const QXmlStreamAttributes attributes = reader.attributes();
+                bool ok = false;
+                const int image = attributes.value(u"Image").toInt(&ok);
+                if (!ok) {
+                    return {};
+                }
+                order.push_back(image);
+                sizes.emplace_back(attributes.value(u"ImageWidth").toInt(), attributes.value(u"ImageHeight").toInt());
+            }
+            reader.skipCurrentElement();
+        }
+        break;
+    }
+    if (reader.hasError() || order.empty() || order.size() != static_cast<size_t>(files->count())) {
+        return {};
+    }
+
+    // every image exactly once
+    std::vector<bool> seen(order.size(), false);
+    for (const int image : order) {
+        if (image < 0 || image >= static_cast<int>(order.size()) || seen[image]) {
+            return {};
+        }
+        seen[image] = true;
+    }
+
+    QStringList ordered;
+    ordered.reserve(files->count());
+    for (const int image : order) {
+        ordered.append(files->at(image));
+    }
+    *files = ordered;
+    for (QSize &size : sizes) {
+        if (!size.isValid() || size.isEmpty()) {
+            size = QSize();
+        }
+    }
+    return sizes;
+}
+
+} // namespace ComicInfo
@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef COMICINFO_H
+#define COMICINFO_H
+
+#include <QByteArray>
+#include <QSize>
+#include <QStringList>
+
+#include <vector>
+
+namespace ComicInfo
+{
+
+// name of the metadata file at the root of comic book archives
+inline constexpr QLatin1String FileName{"ComicInfo.xml"};
+
+// applies the <Pages> list of a ComicInfo.xml to the naturally sorted images it describes:
+// files is reordered as the pages are listed and the page sizes are returned in that order,
+// invalid where ImageWidth or ImageHeight are missing;
+// when the list doesn't match files (count or indexes) files is unchanged and nothing is returned
+auto applyPages(const QByteArray &xml, QStringList *files) -> std::vector<QSize>;
+
+} // namespace ComicInfo
+
+#endif // COMICINFO_H
@@ -0,0 +1,824 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "compressedtarreader.h"
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QDateTime>
+#include <QScopeGuard>
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+#include <KLocalizedString>
+
+#include <zlib.h>
+#ifdef WITH_LIBLZMA
+#include <lzma.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "metadatacache.h"
+
+namespace
+{
+
+constexpr quint32 IndexVersion = 2;
+constexpr qint64 ChunkSize = 64 * 1024;
+// how far back deflate can refer, kept with every gzip checkpoint
+constexpr qint64 WindowSize = 32 * 1024;
+// gzip header and trailer, no zlib header
+constexpr int GzipWindowBits = MAX_WBITS + 16;
+// least decompressed data between two gzip checkpoints, each one stores a window
+constexpr qint64 MinSpan = 1024 * 1024;
+constexpr qint64 BlockSize = 512;
+// longest GNU long name or pax header that is read
+constexpr qint64 MaxExtendedSize = 64 * 1024;
+
+const QByteArray GzipMagic = QByteArrayLiteral("\x1f\x8b");
+const QByteArray XzMagic = QByteArray("\xfd" "7zXZ\0", 6);
+
+class CompressedTarFile : public KArchiveFile
+{
+public:
+    CompressedTarFile(CompressedTarReader *reader, const QString &name, int access, const QDateTime &date, qint64 index, qint64 size)
+        : KArchiveFile(reader, name, access, date, QString(), QString(), QString(), index, size)
+        , m_reader{reader}
+    {
+    }
+
+    auto data() const -> QByteArray override
+    {
+        return m_reader->entryData(position());
+    }
+
+    auto createDevice() const -> QIODevice * override
+    {
+        auto buffer = new QBuffer();
+        buffer->setData(data());
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+
+private:
+    CompressedTarReader *m_reader;
+};
+
+} // namespace
+
+class CompressedTarReader::TarScanner
+{
+public:
+    explicit TarScanner(std::vector<Entry> *entries)
+        : m_entries{entries}
+    {
+    }
+
+    // takes the next part of the tar, returns false once it isn't a tar file
+    auto feed(const char *data, qint64 size) -> bool
+    {
+        while (size > 0 && m_valid && !m_finished) {
+            if (m_skip > 0) {
+                const qint64 n = std::min(m_skip, size);
+                if (m_captureSize > 0) {
+                    const qint64 captured = std::min(n, m_captureSize);
+                    m_extended.append(data, captured);
+                    m_captureSize -= captured;
+                    if (m_captureSize == 0) {
+                        readExtended();
+                    }
+                }
+                m_skip -= n;
+                m_pos += n;
+                data += n;
+                size -= n;
+                continue;
+            }
+            const qint64 n = std::min(BlockSize - m_header.size(), size);
+            m_header.append(data, n);
+            m_pos += n;
+            data += n;
+            size -= n;
+            if (m_header.size() == BlockSize) {
+                m_valid = readHeader();
+                m_header.clear();
+            }
+        }
+        return m_valid;
+    }
+
+    // the end of archive block was read
+    auto finished() const -> bool
+    {
+        return m_finished;
+    }
+
+    auto valid() const -> bool
+    {
+        return m_valid;
+    }
+
+    // bytes of the tar fed so far
+    auto position() const -> qint64
+    {
+        return m_pos;
+    }
+
+    // offset of the data of the last file found, -1 before the first one
+    auto lastOffset() const -> qint64
+    {
+        return m_entries->empty() ? -1 : m_entries->back().offset;
+    }
+
+private:
+    // octal, or base-256 when the high bit of the first byte is set (GNU tar, for large values)
+    static auto number(const char *field, int size) -> qint64
+    {
+        qint64 value = 0;
+        if (static_cast<uchar>(field[0]) & 0x80) {
+            value = field[0] & 0x7f;
+            for (int i = 1; i < size; ++i) {
+                if (value > (std::numeric_limits<qint64>::max() >> 8)) {
+                    return -1;
+                }
+                value = (value << 8) | static_cast<uchar>(field[i]);
+            }
+            return value;
+        }
+        int i = 0;
+        while (i < size && field[i] == ' ') {
+            ++i;
+        }
+        for (; i < size && field[i] >= '0' && field[i] <= '7'; ++i) {
+            if (value > (std::numeric_limits<qint64>::max() >> 3)) {
+                return -1;
+            }
+            value = (value << 3) | (field[i] - '0');
+        }
+        return value;
+    }
+
+    static auto string(const char *field, int size) -> QByteArray
+    {
+        return {field, static_cast<qsizetype>(qstrnlen(field, size))};
+    }
+
+    auto readHeader() -> bool
+    {
+        const char *header = m_header.constData();
+        if (std::all_of(header, header + BlockSize, [](char c) { return c == 0; })) {
+            m_finished = true;
+            return true;
+        }
+
+        // the checksum is computed with its own field as spaces, old tars summed signed chars
+        qint64 sum = 0;
+        qint64 signedSum = 0;
+        for (int i = 0; i < BlockSize; ++i) {
+            const bool checksum = i >= 148 && i < 156;
+            sum += checksum ? ' ' : static_cast<uchar>(header[i]);
+            signedSum += checksum ? ' ' : static_cast<signed char>(header[i]);
+        }
+        const qint64 checksum = number(header + 148, 8);
+        if (checksum != sum && checksum != signedSum) {
+            return false;
+        }
+
+        const char type = header[156];
+        const bool extended = type == 'L' || type == 'x' || type == 'g';
+        // a pax size replaces the header's for the entry that follows it
+        const qint64 size = !extended && m_paxSize >= 0 ? m_paxSize : number(header + 124, 12);
+        // base-256 sizes go up to 2^63, rounding up to whole blocks must not overflow
+        if (size < 0 || size > std::numeric_limits<qint64>::max() - BlockSize) {
+            return false;
+        }
+        m_skip = (size + BlockSize - 1) / BlockSize * BlockSize;
+
+        if (type == 'L' || type == 'x') {
+            m_extended.clear();
+            m_extendedType = type;
+            m_captureSize = size <= MaxExtendedSize ? size : 0;
+            if (size == 0) {
+                readExtended();
+            }
+            return true;
+        }
+        if (type == 'g') {
+            return true;
+        }
+
+        if (type == '0' || type == '\0' || type == '7') {
+            QString path = m_paxPath;
+            if (path.isEmpty()) {
+                path = QString::fromUtf8(m_longName);
+            }
+            if (path.isEmpty()) {
+                QByteArray name = string(header, 100);
+                // posix ustar splits long paths, GNU tar keeps other fields there
+                if (memcmp(header + 257, "ustar\0", 6) == 0) {
+                    const QByteArray prefix = string(header + 345, 155);
+                    if (!prefix.isEmpty()) {
+                        name = prefix + '/' + name;
+                    }
+                }
+                path = QString::fromUtf8(name);
+            }
+            while (path.startsWith(QLatin1String("./"))) {
+                path.remove(0, 2);
+            }
+            while (path.startsWith(QLatin1Char('/'))) {
+                path.remove(0, 1);
+            }
+            if (!path.isEmpty() && !path.endsWith(QLatin1Char('/'))) {
+                m_entries->push_back({path, m_pos, size, static_cast<qint32>(number(header + 100, 8) & 07777),
+                                      number(header + 136, 12)});
+            }
+        }
+        // the extended headers only apply to the entry right after them
+        m_longName.clear();
+        m_paxPath.clear();
+        m_paxSize = -1;
+        return true;
+    }
+
+    void readExtended()
+    {
+        if (m_extendedType == 'L') {
+            m_longName = string(m_extended.constData(), static_cast<int>(m_extended.size()));
+            return;
+        }
+        // pax records are "<length> <key>=<value>\n", length counts the whole record
+        qsizetype pos = 0;
+        while (pos < m_extended.size()) {
+            const qsizetype space = m_extended.indexOf(' ', pos);
+            if (space < 0) {
+                return;
+            }
+            bool ok = false;
+            const qsizetype length = m_extended.mid(pos, space - pos).toLongLong(&ok);
+            if (!ok || length <= space - pos + 1 || pos + length > m_extended.size()) {
+                return;
+            }
+            const QByteArray record = m_extended.mid(space + 1, pos + length - space - 2);
+            const qsizetype equals = record.indexOf('=');
+            if (equals > 0) {
+                const QByteArray key = record.left(equals);
+                const QByteArray value = record.mid(equals + 1);
+                if (key == "path") {
+                    m_paxPath = QString::fromUtf8(value);
+                } else if (key == "size") {
+                    m_paxSize = value.toLongLong(&ok);
+                    if (!ok) {
+                        m_paxSize = -1;
+                    }
+                }
+            }
+            pos += length;
+        }
+    }
+
+    std::vector<Entry> *m_entries;
+    // offset in the tar of the next byte fed
+    qint64 m_pos{0};
+    // data and padding of the current entry still to be passed over
+    qint64 m_skip{0};
+    QByteArray m_header;
+    // long name or pax header being read
+    QByteArray m_extended;
+    char m_extendedType{0};
+    qint64 m_captureSize{0};
+    QByteArray m_longName;
+    QString m_paxPath;
+    qint64 m_paxSize{-1};
+    bool m_valid{true};
+    bool m_finished{false};
+};
+
+CompressedTarReader::CompressedTarReader(const QString &fileName)
+    : KArchive(fileName)
+    , m_path{fileName}
+{
+}
+
+CompressedTarReader::CompressedTarReader(QIODevice *dev, const QString &path)
+    : KArchive(dev)
+    , m_path{path}
+{
+}
+
+CompressedTarReader::~CompressedTarReader()
+{
+    if (isOpen()) {
+        close();
+    }
+}
+
+auto CompressedTarReader::openArchive(QIODevice::OpenMode mode) -> bool
+{
+    QIODevice *dev = device();
+    if (mode != QIODevice::ReadOnly || !dev->seek(0)) {
+        return false;
+    }
+    const QByteArray magic = dev->read(XzMagic.size());
+    if (magic.startsWith(GzipMagic)) {
+        m_format = Format::Gzip;
+    } else if (magic == XzMagic) {
+        m_format = Format::Xz;
+#ifndef WITH_LIBLZMA
+        setErrorString(i18n("Reading xz compressed files needs liblzma"));
+        return false;
+#endif
+    } else {
+        setErrorString(i18n("Not a gzip or xz compressed file"));
+        return false;
+    }
+
+    // the index is only built the first time the file is opened
+    QByteArray index;
+    if (!MetadataCache::loadIndex(m_path, &index) || !readIndex(index)) {
+        if (!buildIndex()) {
+            m_checkpoints.clear();
+            m_entries.clear();
+            setErrorString(i18n("Invalid compressed tar file"));
+            return false;
+        }
+        MetadataCache::saveIndex(m_path, writeIndex());
+    }
+
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        const Entry &entry = m_entries[i];
+        const int slash = entry.path.lastIndexOf(QLatin1Char('/'));
+        KArchiveDirectory *parent = slash < 0 ? rootDir() : findOrCreate(entry.path.left(slash));
+        auto file = new CompressedTarFile(this, entry.path.mid(slash + 1), entry.access,
+                                          QDateTime::fromSecsSinceEpoch(entry.mtime), static_cast<qint64>(i), entry.size);
+        if (!parent->addEntryV2(file)) {
+            delete file;
+        }
+    }
+    return true;
+}
+
+auto CompressedTarReader::closeArchive() -> bool
+{
+    m_checkpoints.clear();
+    m_entries.clear();
+    return true;
+}
+
+auto CompressedTarReader::entryData(qint64 index) -> QByteArray
+{
+    if (index < 0 || index >= static_cast<qint64>(m_entries.size())) {
+        return {};
+    }
+    const Entry &entry = m_entries[index];
+    if (entry.size <= 0) {
+        return {};
+    }
+    QByteArray data;
+    data.reserve(entry.size);
+    const qint64 end = entry.offset + entry.size;
+    const bool ok = decompress(entry.offset, [&](qint64 offset, const char *chunk, qint64 size) {
+        const qint64 from = std::max(offset, entry.offset);
+        const qint64 to = std::min(offset + size, end);
+        if (from < to) {
+            data.append(chunk + (from - offset), to - from);
+        }
+        return offset + size < end;
+    });
+    if (!ok || data.size() != entry.size) {
+        return {};
+    }
+    return data;
+}
+
+auto CompressedTarReader::decompress(qint64 offset, const Sink &sink) -> bool
+{
+    const auto next = std::upper_bound(m_checkpoints.cbegin(), m_checkpoints.cend(), offset,
+                                       [](qint64 value, const Checkpoint &checkpoint) {
+                                           return value < checkpoint.out;
+                                       });
+    if (m_format == Format::Xz) {
+        return next != m_checkpoints.cbegin()
+                && decodeXzFrom(static_cast<size_t>(std::distance(m_checkpoints.cbegin(), next) - 1), sink);
+    }
+    return inflateFrom(next == m_checkpoints.cbegin() ? nullptr : &*std::prev(next), sink);
+}
+
+auto CompressedTarReader::buildIndex() -> bool
+{
+    m_checkpoints.clear();
+    m_entries.clear();
+    TarScanner scanner(&m_entries);
+    const bool built = m_format == Format::Gzip ? buildGzipIndex(scanner) : buildXzIndex(scanner);
+    // a tar that ends without the end of archive block can end in the middle of the last entry,
+    // entries are only kept when all of their data was decompressed
+    m_size = scanner.position();
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [this](const Entry &entry) {
+        return entry.offset > m_size || entry.size > m_size - entry.offset;
+    }), m_entries.end());
+    return built && scanner.valid();
+}
+
+// gzip
+
+auto CompressedTarReader::buildGzipIndex(TarScanner &scanner) -> bool
+{
+    QIODevice *dev = device();
+    if (!dev->seek(0)) {
+        return false;
+    }
+    z_stream stream{};
+    if (inflateInit2(&stream, GzipWindowBits) != Z_OK) {
+        return false;
+    }
+    const auto cleanup = qScopeGuard([&] {
+        inflateEnd(&stream);
+    });
+
+    QByteArray input(ChunkSize, Qt::Uninitialized);
+    // the output goes round through the window, so its last 32 KiB are always at hand
+    QByteArray window(WindowSize, Qt::Uninitialized);
+    qint64 windowPos = 0;
+    bool windowFull = false;
+    qint64 totalIn = 0;
+    qint64 totalOut = 0;
+    // the last block boundary, becomes a checkpoint when an entry's data starts after it
+    Checkpoint candidate{-1, -1, 0, {}};
+    // the start of the file needs no checkpoint
+    qint64 lastCheckpoint = 0;
+    int result = Z_OK;
+    while (!scanner.finished()) {
+        if (stream.avail_in == 0) {
+            const qint64 read = dev->read(input.data(), input.size());
+            if (read <= 0) {
+                // a tar without the end of archive block ends with the last gzip member
+                return read == 0 && result == Z_STREAM_END;
+            }
+            stream.next_in = reinterpret_cast<Bytef *>(input.data());
+            stream.avail_in = static_cast<uInt>(read);
+        }
+        if (result == Z_STREAM_END) {
+            // concatenated gzip members
+            inflateReset(&stream);
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(window.data() + windowPos);
+        stream.avail_out = static_cast<uInt>(WindowSize - windowPos);
+        const uInt availIn = stream.avail_in;
+        const uInt availOut = stream.avail_out;
+        // returns at every deflate block boundary
+        result = inflate(&stream, Z_BLOCK);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            return false;
+        }
+        totalIn += availIn - stream.avail_in;
+        const qint64 produced = availOut - stream.avail_out;
+        if (!scanner.feed(window.constData() + windowPos, produced)) {
+            return false;
+        }
+        totalOut += produced;
+        windowPos += produced;
+        if (windowPos == WindowSize) {
+            windowPos = 0;
+            windowFull = true;
+        }
+
+        if (candidate.out >= 0 && scanner.lastOffset() >= candidate.out) {
+            if (candidate.out - lastCheckpoint >= MinSpan) {
+                lastCheckpoint = candidate.out;
+                m_checkpoints.push_back(std::move(candidate));
+            }
+            candidate = Checkpoint{-1, -1, 0, {}};
+        }
+        // bit 128: at a block boundary, bit 64: after the last block
+        if (result != Z_STREAM_END && (stream.data_type & 128) && !(stream.data_type & 64)) {
+            candidate.in = totalIn;
+            candidate.out = totalOut;
+            candidate.bits = stream.data_type & 7;
+            candidate.window = windowFull ? window.mid(windowPos) + window.left(windowPos) : window.left(windowPos);
+        }
+    }
+    return true;
+}
+
+auto CompressedTarReader::inflateFrom(const Checkpoint *checkpoint, const Sink &sink) -> bool
+{
+    QIODevice *dev = device();
+    z_stream stream{};
+    // a checkpoint is inside a raw deflate stream, the gzip header is before it
+    bool raw = checkpoint != nullptr;
+    if (inflateInit2(&stream, raw ? -MAX_WBITS : GzipWindowBits) != Z_OK) {
+        return false;
+    }
+    const auto cleanup = qScopeGuard([&] {
+        inflateEnd(&stream);
+    });
+
+    qint64 offset = 0;
+    if (checkpoint) {
+        if (!dev->seek(checkpoint->in - (checkpoint->bits ? 1 : 0))) {
+            return false;
+        }
+        if (checkpoint->bits) {
+            char byte = 0;
+            if (!dev->getChar(&byte)) {
+                return false;
+            }
+            inflatePrime(&stream, checkpoint->bits, static_cast<uchar>(byte) >> (8 - checkpoint->bits));
+        }
+        if (!checkpoint->window.isEmpty()) {
+            inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(checkpoint->window.constData()),
+                                 static_cast<uInt>(checkpoint->window.size()));
+        }
+        offset = checkpoint->out;
+    } else if (!dev->seek(0)) {
+        return false;
+    }
+
+    QByteArray input(ChunkSize, Qt::Uninitialized);
+    QByteArray output(ChunkSize, Qt::Uninitialized);
+    // the trailer after a raw deflate stream, inflate only skips it when it read the header
+    qint64 trailer = 0;
+    int result = Z_OK;
+    while (true) {
+        if (stream.avail_in == 0) {
+            const qint64 read = dev->read(input.data(), input.size());
+            if (read <= 0) {
+                return read == 0 && result == Z_STREAM_END;
+            }
+            stream.next_in = reinterpret_cast<Bytef *>(input.data());
+            stream.avail_in = static_cast<uInt>(read);
+        }
+        if (trailer > 0) {
+            const auto skipped = static_cast<uInt>(std::min<qint64>(trailer, stream.avail_in));
+            stream.next_in += skipped;
+            stream.avail_in -= skipped;
+            trailer -= skipped;
+            continue;
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            return false;
+        }
+        const qint64 produced = output.size() - stream.avail_out;
+        if (produced > 0) {
+            if (!sink(offset, output.constData(), produced)) {
+                return true;
+            }
+            offset += produced;
+        }
+        if (result == Z_STREAM_END) {
+            // the next member is read with its header
+            if (raw) {
+                raw = false;
+                trailer = 8;
+                inflateReset2(&stream, GzipWindowBits);
+            } else {
+                inflateReset(&stream);
+            }
+        }
+    }
+}
+
+// xz
+
+auto CompressedTarReader::buildXzIndex(TarScanner &scanner) -> bool
+{
+#ifdef WITH_LIBLZMA
+    // the blocks are listed in the index at the end of the stream, found through the stream footer;
+    // only the stream padding, a multiple of 4 zero bytes, can come after it
+    QIODevice *dev = device();
+    qint64 end = dev->size();
+    QByteArray footer;
+    while (true) {
+        if (end < 2 * LZMA_STREAM_HEADER_SIZE || !dev->seek(end - LZMA_STREAM_HEADER_SIZE)) {
+            return false;
+        }
+        footer = dev->read(LZMA_STREAM_HEADER_SIZE);
+        if (footer.size() != LZMA_STREAM_HEADER_SIZE) {
+            return false;
+        }
+        if (!footer.endsWith(QByteArray(4, '\0'))) {
+            break;
+        }
+        end -= 4;
+    }
+    lzma_stream_flags flags;
+    if (lzma_stream_footer_decode(&flags, reinterpret_cast<const uint8_t *>(footer.constData())) != LZMA_OK) {
+        return false;
+    }
+    const auto indexSize = static_cast<qint64>(flags.backward_size);
+    if (end - LZMA_STREAM_HEADER_SIZE - indexSize < LZMA_STREAM_HEADER_SIZE
+            || !dev->seek(end - LZMA_STREAM_HEADER_SIZE - indexSize)) {
+        return false;
+    }
+    const QByteArray indexData = dev->read(indexSize);
+    if (indexData.size() != indexSize) {
+        return false;
+    }
+    lzma_index *index = nullptr;
+    uint64_t memoryLimit = std::numeric_limits<uint64_t>::max();
+    size_t pos = 0;
+    if (lzma_index_buffer_decode(&index, &memoryLimit, nullptr, reinterpret_cast<const uint8_t *>(indexData.constData()),
+                                 &pos, indexData.size()) != LZMA_OK) {
+        return false;
+    }
+    const auto cleanup = qScopeGuard([&] {
+        lzma_index_end(index, nullptr);
+    });
+    // the offsets of blocks in concatenated streams would need every stream's index
+    if (lzma_index_file_size(index) != static_cast<lzma_vli>(end)) {
+        return false;
+    }
+    m_check = flags.check;
+    lzma_index_iter iter;
+    lzma_index_iter_init(&iter, index);
+    while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+        m_checkpoints.push_back({static_cast<qint64>(iter.block.compressed_file_offset),
+                                 static_cast<qint64>(iter.block.uncompressed_file_offset), 0, {}});
+    }
+    if (m_checkpoints.empty()) {
+        return false;
+    }
+
+    // the entries are still only found by decompressing everything
+    return decodeXzFrom(0, [&](qint64, const char *data, qint64 size) {
+        return scanner.feed(data, size) && !scanner.finished();
+    });
+#else
+    Q_UNUSED(scanner)
+    return false;
+#endif
+}
+
+auto CompressedTarReader::decodeXzFrom(size_t checkpoint, const Sink &sink) -> bool
+{
+#ifdef WITH_LIBLZMA
+    // every block is decoded on its own, starting with its header
+    QIODevice *dev = device();
+    QByteArray input(ChunkSize, Qt::Uninitialized);
+    QByteArray output(ChunkSize, Qt::Uninitialized);
+    for (size_t i = checkpoint; i < m_checkpoints.size(); ++i) {
+        const Checkpoint &block = m_checkpoints[i];
+        if (!dev->seek(block.in)) {
+            return false;
+        }
+        QByteArray header = dev->read(1);
+        // a zero size byte starts the index instead
+        if (header.size() != 1 || header.at(0) == 0) {
+            return false;
+        }
+        const qint64 headerSize = lzma_block_header_size_decode(static_cast<uchar>(header.at(0)));
+        header += dev->read(headerSize - 1);
+        if (header.size() != headerSize) {
+            return false;
+        }
+        lzma_filter filters[LZMA_FILTERS_MAX + 1];
+        lzma_block options{};
+        options.version = 0;
+        options.check = static_cast<lzma_check>(m_check);
+        options.filters = filters;
+        options.header_size = static_cast<uint32_t>(headerSize);
+        if (lzma_block_header_decode(&options, nullptr, reinterpret_cast<const uint8_t *>(header.constData())) != LZMA_OK) {
+            return false;
+        }
+        lzma_stream stream = LZMA_STREAM_INIT;
+        const lzma_ret init = lzma_block_decoder(&stream, &options);
+        // the decoder keeps its own copy of the filter options
+        for (int f = 0; filters[f].id != LZMA_VLI_UNKNOWN; ++f) {
+            free(filters[f].options);
+        }
+        if (init != LZMA_OK) {
+            return false;
+        }
+        const auto cleanup = qScopeGuard([&] {
+            lzma_end(&stream);
+        });
+
+        qint64 offset = block.out;
+        lzma_ret result = LZMA_OK;
+        while (result != LZMA_STREAM_END) {
+            if (stream.avail_in == 0) {
+                const qint64 read = dev->read(input.data(), input.size());
+                if (read <= 0) {
+                    return false;
+                }
+                stream.next_in = reinterpret_cast<const uint8_t *>(input.constData());
+                stream.avail_in = static_cast<size_t>(read);
+            }
+            stream.next_out = reinterpret_cast<uint8_t *>(output.data());
+            stream.avail_out = static_cast<size_t>(output.size());
+            result = lzma_code(&stream, LZMA_RUN);
+            if (result != LZMA_OK && result != LZMA_STREAM_END) {
+                return false;
+            }
+            const qint64 produced = output.size() - static_cast<qint64>(stream.avail_out);
+            if (produced > 0) {
+                if (!sink(offset, output.constData(), produced)) {
+                    return true;
+                }
+                offset += produced;
+            }
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(checkpoint)
+    Q_UNUSED(sink)
+    return false;
+#endif
+}
+
+// index
+
+auto CompressedTarReader::readIndex(const QByteArray &index) -> bool
+{
+    QDataStream in(index);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 version = 0;
+    quint8 format = 0;
+    in >> version >> format >> m_check >> m_size;
+    if (version != IndexVersion || format != static_cast<quint8>(m_format)) {
+        return false;
+    }
+
+    // the counts come from the file, every item takes at least a byte
+    quint32 count = 0;
+    in >> count;
+    if (in.status() != QDataStream::Ok || count > static_cast<quint32>(index.size())) {
+        return false;
+    }
+    m_checkpoints.resize(count);
+    for (Checkpoint &checkpoint : m_checkpoints) {
+        in >> checkpoint.in >> checkpoint.out >> checkpoint.bits >> checkpoint.window;
+    }
+    in >> count;
+    if (in.status() != QDataStream::Ok || count > static_cast<quint32>(index.size())) {
+        m_checkpoints.clear();
+        return false;
+    }
+    m_entries.resize(count);
+    bool valid = true;
+    for (Entry &entry : m_entries) {
+        in >> entry.path >> entry.offset >> entry.size >> entry.access >> entry.mtime;
+        valid = valid && entry.offset >= 0 && entry.size >= 0 && entry.offset <= m_size && entry.size <= m_size - entry.offset;
+    }
+    if (in.status() != QDataStream::Ok || !valid) {
+        m_checkpoints.clear();
+        m_entries.clear();
+        return false;
+    }
+    return true;
+}
+
+auto CompressedTarReader::writeIndex() const -> QByteArray
+{
+    QByteArray index;
+    QDataStream out(&index, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << IndexVersion << static_cast<quint8>(m_format) << m_check << m_size;
+    out << static_cast<quint32>(m_checkpoints.size());
+    for (const Checkpoint &checkpoint : m_checkpoints) {
+        out << checkpoint.in << checkpoint.out << checkpoint.bits << checkpoint.window;
+    }
+    out << static_cast<quint32>(m_entries.size());
+    for (const Entry &entry : m_entries) {
+        out << entry.path << entry.offset << entry.size << entry.access << entry.mtime;
+    }
+    return index;
+}
+
+// read only
+
+auto CompressedTarReader::doWriteDir(const QString &, const QString &, const QString &,
+                                     mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto CompressedTarReader::doWriteSymLink(const QString &, const QString &, const QString &, const QString &,
+                                         mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto CompressedTarReader::doPrepareWriting(const QString &, const QString &, const QString &, qint64,
+                                           mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto CompressedTarReader::doFinishWriting(qint64) -> bool
+{
+    return false;
+}
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef COMPRESSEDTARREADER_H
+#define COMPRESSEDTARREADER_H
+
+#include <KArchive>
+
+#include <QByteArray>
+
+#include <functional>
+#include <vector>
+
+// read only KArchive for gzip and (with liblzma) xz compressed tar files;
+// an entry is decompressed starting from the nearest checkpoint before it instead of from the beginning.
+// The checkpoints and the entries are found by decompressing the file once,
+// that index is kept in the metadata cache so later opens don't decompress anything
+class CompressedTarReader : public KArchive
+{
+public:
+    enum class Format : quint8 {
+        Gzip,
+        Xz,
+    };
+
+    struct Entry {
+        QString path;
+        // of the entry's data in the decompressed tar
+        qint64 offset;
+        qint64 size;
+        qint32 access;
+        qint64 mtime;
+    };
+
+    // where decompression can start without decompressing what comes before
+    struct Checkpoint {
+        // gzip: the first byte not fully used, xz: the block header
+        qint64 in;
+        // offset in the decompressed tar
+        qint64 out;
+        // gzip: bits of the byte before in that weren't used yet
+        qint32 bits;
+        // gzip: the last 32 KiB decompressed before out, deflate refers back into them
+        QByteArray window;
+    };
+
+    // receives the decompressed data in order, offset is where data starts in the tar; returns false to stop
+    using Sink = std::function<bool(qint64 offset, const char *data, qint64 size)>;
+
+    explicit CompressedTarReader(const QString &fileName);
+    // path is the archive file the index is stored for
+    CompressedTarReader(QIODevice *dev, const QString &path);
+    ~CompressedTarReader() override;
+
+    // data of the entry at the given position, its order in the tar file
+    auto entryData(qint64 index) -> QByteArray;
+
+protected:
+    auto openArchive(QIODevice::OpenMode mode) -> bool override;
+    auto closeArchive() -> bool override;
+    auto doWriteDir(const QString &name, const QString &user, const QString &group,
+                    mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doWriteSymLink(const QString &name, const QString &target, const QString &user, const QString &group,
+                        mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doPrepareWriting(const QString &name, const QString &user, const QString &group, qint64 size,
+                          mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doFinishWriting(qint64 size) -> bool override;
+
+private:
+    // finds the entries in the decompressed tar
+    class TarScanner;
+
+    auto buildIndex() -> bool;
+    auto buildGzipIndex(TarScanner &scanner) -> bool;
+    auto buildXzIndex(TarScanner &scanner) -> bool;
+    // decompresses from the last checkpoint at or before offset
+    auto decompress(qint64 offset, const Sink &sink) -> bool;
+    auto inflateFrom(const Checkpoint *checkpoint, const Sink &sink) -> bool;
+    auto decodeXzFrom(size_t checkpoint, const Sink &sink) -> bool;
+    auto readIndex(const QByteArray &index) -> bool;
+    auto writeIndex() const -> QByteArray;
+
+    QString m_path;
+    Format m_format{Format::Gzip};
+    // xz: lzma_check of the stream, needed to decode its blocks
+    qint32 m_check{0};
+    // of the decompressed tar, every entry lies within it
+    qint64 m_size{0};
+    std::vector<Checkpoint> m_checkpoints;
+    std::vector<Entry> m_entries;
+};
+
+#endif // COMPRESSEDTARREADER_H
@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "extractioncache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+// written when unrar exits successfully, its modification time is the last use
+const QString CompleteMarker = QStringLiteral(".complete");
+const QString DiscardedSuffix = QStringLiteral(".discarded");
+// unfinished extractions this old are left over from a previous run
+constexpr qint64 AbandonedAfter = 24 * 60 * 60;
+
+auto cacheFolder() -> QString
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/extracted");
+}
+
+auto folderSize(const QString &path) -> qint64
+{
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
+
+} // namespace
+
+namespace ExtractionCache
+{
+
+auto folder(const QString &archiveFile) -> QString
+{
+    const QFileInfo fi(archiveFile);
+    const QString key = fi.absoluteFilePath() + QLatin1Char('\n') + QString::number(fi.size())
+            + QLatin1Char('\n') + QString::number(fi.lastModified().toMSecsSinceEpoch());
+    const QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return cacheFolder() + QLatin1Char('/') + QString::fromLatin1(hash);
+}
+
+auto use(const QString &folder) -> bool
+{
+    const QString marker = folder + QLatin1Char('/') + CompleteMarker;
+    if (!QFileInfo::exists(marker)) {
+        return false;
+    }
+    QFile file(marker);
+    if (file.open(QIODevice::ReadWrite)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return true;
+}
+
+void setComplete(const QString &folder)
+{
+    QFile marker(folder + QLatin1Char('/') + CompleteMarker);
+    if (marker.open(QIODevice::WriteOnly)) {
+        marker.close();
+    }
+}
+
+void discard(const QString &folder)
+{
+    if (!QFileInfo::exists(folder)) {
+        return;
+    }
+    const QString name = folder + QLatin1Char('-') + QString::number(QDateTime::currentMSecsSinceEpoch()) + DiscardedSuffix;
+    QDir().rename(folder, name);
+}
+
+void prune(qint64 budget, const QString &keep)
+{
+    QThreadPool::globalInstance()->start([budget, keep]() {
+        struct Extraction {
+            QString path;
+            qint64 size;
+            QDateTime lastUsed;
+        };
+        std::vector<Extraction> extractions;
+        qint64 total = 0;
+        const QDateTime now = QDateTime::currentDateTime();
+
+        const QFileInfoList folders = QDir(cacheFolder()).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QFileInfo &fi : folders) {
+            const QString path = fi.absoluteFilePath();
+            if (path == keep) {
+                total += folderSize(path);
+                continue;
+            }
+            const QFileInfo marker(path + QLatin1Char('/') + CompleteMarker);
+            if (path.endsWith(DiscardedSuffix)
+                    || (!marker.exists() && fi.lastModified().secsTo(now) > AbandonedAfter)) {
+                QDir(path).removeRecursively();
+                continue;
+            }
+            // still being extracted by another instance
+            if (!marker.exists()) {
+                continue;
+            }
+            const qint64 size = folderSize(path);
+            total += size;
+            extractions.push_back({path, size, marker.lastModified()});
+        }
+
+        std::sort(extractions.begin(), extractions.end(), [](const Extraction &a, const Extraction &b) {
+            return a.lastUsed < b.lastUsed;
+        });
+        for (const Extraction &extraction : extractions) {
+            if (total <= budget) {
+                break;
+            }
+            // used while the sizes were added up, the other folders are older
+            const QFileInfo marker(extraction.path + QLatin1Char('/') + CompleteMarker);
+            if (!marker.exists() || marker.lastModified() != extraction.lastUsed) {
+                continue;
+            }
+            // renamed first, a use() from now on doesn't find it and extracts again
+            const QString discarded = extraction.path + QLatin1Char('-')
+                    + QString::number(QDateTime::currentMSecsSinceEpoch()) + DiscardedSuffix;
+            if (!QDir().rename(extraction.path, discarded)) {
+                continue;
+            }
+            QDir(discarded).removeRecursively();
+            total -= extraction.size;
+        }
+    });
+}
+
+} // namespace ExtractionCache
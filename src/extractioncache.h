@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef EXTRACTIONCACHE_H
+#define EXTRACTIONCACHE_H
+
+#include <QString>
+
+// folders under QStandardPaths::CacheLocation that archives are extracted to,
+// kept between runs and removed least recently used first
+namespace ExtractionCache
+{
+
+// folder archiveFile is extracted to, it changes when the archive's size or modification time does
+auto folder(const QString &archiveFile) -> QString;
+
+// true when the extraction to folder finished, marks it as the most recently used
+auto use(const QString &folder) -> bool;
+
+// marks the extraction to folder as finished
+void setComplete(const QString &folder);
+
+// moves what an interrupted extraction left in folder out of the way, it is deleted by prune()
+void discard(const QString &folder);
+
+// on a separate thread: deletes discarded folders and the least recently used extractions
+// until the cache takes at most budget bytes, keep is never deleted
+void prune(qint64 budget, const QString &keep);
+
+} // namespace ExtractionCache
+
+#endif // EXTRACTIONCACHE_H
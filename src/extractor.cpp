@@ -9,10 +9,11 @@
 
 #include <QCollator>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QMimeDatabase>
 #include <QProcess>
-#include <QTemporaryDir>
+#include <QThread>
 
 #include <KLocalizedString>
 #include <KTar>
@@ -22,7 +23,107 @@
 #include <K7Zip>
 #endif
 
+#include "comicinfo.h"
+#include "compressedtarreader.h"
+#include "extractioncache.h"
+#ifdef WITH_LIBARCHIVE
+#include "libarchivereader.h"
+#endif
+#include "metadatacache.h"
 #include "settings.h"
+#include "zipreader.h"
+
+#include <functional>
+#include <memory>
+
+namespace
+{
+
+// reads the archive file, reporting how far into it the reads got
+// and failing them once the open was cancelled
+class ProgressDevice : public QIODevice
+{
+public:
+    ProgressDevice(const QString &fileName, const Extractor::Token &cancel, std::function<void(int)> progress)
+        : m_file{fileName}
+        , m_cancel{cancel}
+        , m_progress{std::move(progress)}
+    {
+    }
+
+    // the archive keeps reading through the device after it was opened
+    void detach()
+    {
+        m_cancel.reset();
+        m_progress = nullptr;
+    }
+
+    auto open(OpenMode mode) -> bool override
+    {
+        return m_file.open(mode) && QIODevice::open(mode);
+    }
+
+    void close() override
+    {
+        QIODevice::close();
+        m_file.close();
+    }
+
+    auto isSequential() const -> bool override
+    {
+        return false;
+    }
+
+    auto size() const -> qint64 override
+    {
+        return m_file.size();
+    }
+
+    auto seek(qint64 pos) -> bool override
+    {
+        return QIODevice::seek(pos) && m_file.seek(pos);
+    }
+
+protected:
+    auto readData(char *data, qint64 maxSize) -> qint64 override
+    {
+        if (m_cancel && m_cancel->load()) {
+            return -1;
+        }
+        const qint64 read = m_file.read(data, maxSize);
+        if (m_progress && m_file.size() > 0) {
+            const int percent = static_cast<int>(m_file.pos() * 100 / m_file.size());
+            if (percent != m_percent) {
+                m_percent = percent;
+                m_progress(percent);
+            }
+        }
+        return read;
+    }
+
+    auto writeData(const char *data, qint64 maxSize) -> qint64 override
+    {
+        Q_UNUSED(data)
+        Q_UNUSED(maxSize)
+        return -1;
+    }
+
+private:
+    QFile m_file;
+    Extractor::Token m_cancel;
+    std::function<void(int)> m_progress;
+    int m_percent{-1};
+};
+
+auto isRar(const QMimeType &mimetype) -> bool
+{
+    return mimetype.inherits(QStringLiteral("application/x-rar"))
+            || mimetype.inherits(QStringLiteral("application/x-cbr"))
+            || mimetype.inherits(QStringLiteral("application/vnd.rar"))
+            || mimetype.inherits(QStringLiteral("application/vnd.comicbook-rar"));
+}
+
+} // namespace
 
 Extractor::Extractor(QObject *parent)
     : QObject{parent}
@@ -32,78 +133,240 @@ Extractor::Extractor(QObject *parent)
 
 Extractor::~Extractor()
 {
-    delete m_tmpFolder;
+    cancel();
+    for (QThread *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    delete m_device;
+}
+
+void Extractor::cancel()
+{
+    if (m_cancel) {
+        m_cancel->store(true);
+        m_cancel.reset();
+    }
+    if (m_process) {
+        disconnect(m_process, nullptr, this, nullptr);
+        m_process->kill();
+        m_process->deleteLater();
+        m_process = nullptr;
+    }
 }
 
 void Extractor::extractArchive()
 {
-    KArchive *archive {nullptr};
+    // only the newest archive is opened
+    cancel();
+    Token token = std::make_shared<std::atomic_bool>(false);
+    m_cancel = token;
+
+    const QString archiveFile = m_archiveFile;
+    auto device = new ProgressDevice(archiveFile, token, [=](int percent) {
+        QMetaObject::invokeMethod(this, [=]() {
+            if (!token->load()) {
+                Q_EMIT progress(percent);
+            }
+        }, Qt::QueuedConnection);
+    });
+
+    // sniffing, opening and listing read the whole archive for some formats,
+    // so they run on a separate thread and only the results come back
+    QThread *thread = QThread::create([=]() {
+        auto fail = [=]() {
+            QMetaObject::invokeMethod(this, [=]() {
+                delete device;
+                if (!token->load()) {
+                    Q_EMIT error(i18n("Could not open archive: %1", archiveFile));
+                }
+            }, Qt::QueuedConnection);
+        };
+
+        // rar files are extracted to a folder by unrar
+        auto extractRar = [=]() {
+            QMetaObject::invokeMethod(this, [=]() {
+                delete device;
+                if (!token->load()) {
+                    extractRarArchive();
+                }
+            }, Qt::QueuedConnection);
+        };
+        const bool rar = isRar(QMimeDatabase().mimeTypeForFile(archiveFile, QMimeDatabase::MatchContent));
+#ifndef WITH_LIBARCHIVE
+        if (rar) {
+            extractRar();
+            return;
+        }
+#endif
+
+        std::unique_ptr<KArchive> archive;
+        if (device->open(QIODevice::ReadOnly)) {
+            archive.reset(openArchive(archiveFile, device));
+        }
+        if (!archive) {
+            // rar versions and features libarchive doesn't support, unrar still reads them
+            if (rar && !token->load()) {
+                extractRar();
+            } else {
+                fail();
+            }
+            return;
+        }
+        const KArchiveDirectory *directory = archive->directory();
+
+        // the sorted entries are cached, a changed archive doesn't match anymore
+        MangaMetadata metadata;
+        QStringList entries;
+        std::vector<QSize> sizes;
+        if (MetadataCache::load(archiveFile, &metadata)) {
+            entries = metadata.files;
+        } else {
+            // the zip reader has a flat list already
+            if (auto zip = dynamic_cast<const ZipReader *>(archive.get())) {
+                entries = zip->fileNames();
+            } else {
+                getImagesInArchive(QString(), directory, &entries);
+            }
+            // malformed archives can list names that don't find their file
+            entries.removeIf([directory](const QString &entry) {
+                return !directory->file(entry);
+            });
+            QCollator collator;
+            collator.setNumericMode(true);
+            std::sort(entries.begin(), entries.end(), collator);
+
+            // page order and sizes from the archive's metadata, only used when it describes every entry
+            for (int i = 0; i < entries.count(); i++) {
+                if (entries.at(i).compare(ComicInfo::FileName, Qt::CaseInsensitive) == 0) {
+                    const KArchiveFile *comicInfo = directory->file(entries.at(i));
+                    const QByteArray xml = comicInfo ? comicInfo->data() : QByteArray();
+                    entries.removeAt(i);
+                    sizes = ComicInfo::applyPages(xml, &entries);
+                    break;
+                }
+            }
+
+            metadata.files = entries;
+            metadata.offsets.reserve(entries.count());
+            for (const QString &entry : std::as_const(entries)) {
+                const KArchiveFile *file = directory->file(entry);
+                metadata.offsets.push_back(file ? file->position() : -1);
+            }
+            MetadataCache::save(archiveFile, metadata);
+        }
+        device->detach();
+
+        KArchive *result = archive.release();
+        QMetaObject::invokeMethod(this, [=]() {
+            if (token->load()) {
+                delete result;
+                delete device;
+                return;
+            }
+            m_cancel.reset();
+            // the view lets go of the previous archive when it gets the new one
+            QIODevice *previous = m_device;
+            m_device = device;
+            Q_EMIT finishedMemory(result, entries, sizes);
+            delete previous;
+        }, Qt::QueuedConnection);
+    });
+    connect(thread, &QThread::finished, this, [=]() {
+        m_threads.removeOne(thread);
+        thread->deleteLater();
+    });
+    m_threads.append(thread);
+    Q_EMIT progress(0);
+    thread->start();
+}
+
+auto Extractor::createArchive(const QString &archiveFile, QIODevice *device) -> KArchive *
+{
     QMimeDatabase db;
-    const QMimeType mimetype = db.mimeTypeForFile(m_archiveFile, QMimeDatabase::MatchContent);
+    const QMimeType mimetype = db.mimeTypeForFile(archiveFile, QMimeDatabase::MatchContent);
     if (mimetype.inherits(QStringLiteral("application/x-cbz"))
             || mimetype.inherits(QStringLiteral("application/zip"))
             || mimetype.inherits(QStringLiteral("application/vnd.comicbook+zip"))) {
-        archive = new KZip(m_archiveFile);
-#ifdef WITH_K7ZIP
-    } else if (mimetype.inherits(QStringLiteral("application/x-7z-compressed"))
-               || mimetype.inherits(QStringLiteral("application/x-cb7"))) {
-        archive = new K7Zip(m_archiveFile);
+        return device ? new ZipReader(device) : new ZipReader(archiveFile);
+    }
+#ifdef WITH_LIBARCHIVE
+    // only reads the entries that are requested, K7Zip decompresses the whole archive when opening
+    if (isRar(mimetype)
+            || mimetype.inherits(QStringLiteral("application/x-7z-compressed"))
+            || mimetype.inherits(QStringLiteral("application/x-cb7"))) {
+        return device ? new LibArchiveReader(device, archiveFile) : new LibArchiveReader(archiveFile);
+    }
+#elif defined(WITH_K7ZIP)
+    if (mimetype.inherits(QStringLiteral("application/x-7z-compressed"))
+            || mimetype.inherits(QStringLiteral("application/x-cb7"))) {
+        return device ? new K7Zip(device) : new K7Zip(archiveFile);
+    }
 #endif
-    } else if (mimetype.inherits(QStringLiteral("application/x-tar"))
-               || mimetype.inherits(QStringLiteral("application/x-cbt"))) {
-        archive = new KTar(m_archiveFile);
-    } else if (mimetype.inherits(QStringLiteral("application/x-rar"))
-               || mimetype.inherits(QStringLiteral("application/x-cbr"))
-               || mimetype.inherits(QStringLiteral("application/vnd.rar"))
-               || mimetype.inherits(QStringLiteral("application/vnd.comicbook-rar"))) {
-        extractRarArchive();
-        return;
-    } else {
-        Q_EMIT error(i18n("Could not open archive: %1", m_archiveFile));
-        return;
+    if (mimetype.inherits(QStringLiteral("application/x-tar"))
+            || mimetype.inherits(QStringLiteral("application/x-cbt"))) {
+        return device ? new KTar(device) : new KTar(archiveFile);
     }
+    // compressed tar files, the content is only known to be tar once the archive is opened
+    if (mimetype.inherits(QStringLiteral("application/gzip"))
+            || mimetype.inherits(QStringLiteral("application/x-xz"))) {
+        return device ? new CompressedTarReader(device, archiveFile) : new CompressedTarReader(archiveFile);
+    }
+    return nullptr;
+}
 
+auto Extractor::openArchive(const QString &archiveFile, QIODevice *device) -> KArchive *
+{
+    std::unique_ptr<KArchive> archive(createArchive(archiveFile, device));
+    if (!archive) {
+        return nullptr;
+    }
     if (!archive->open(QIODevice::ReadOnly)) {
-        delete archive;
-        archive = nullptr;
-        Q_EMIT error(i18n("Could not open archive: %1", m_archiveFile));
-        return;
+        // zip files with compression methods the zip reader doesn't handle
+        if (!dynamic_cast<ZipReader *>(archive.get())) {
+            return nullptr;
+        }
+        archive.reset();
+        if (device && !device->isOpen() && !device->open(QIODevice::ReadOnly)) {
+            return nullptr;
+        }
+        archive.reset(device ? new KZip(device) : new KZip(archiveFile));
+        if (!archive->open(QIODevice::ReadOnly)) {
+            return nullptr;
+        }
     }
-
-    const KArchiveDirectory *directory = archive->directory();
-    if (!directory) {
-        delete archive;
-        archive = nullptr;
-        Q_EMIT error(i18n("Could not open archive: %1", m_archiveFile));
-        return;
+    if (!archive->directory()) {
+        return nullptr;
     }
-
-    getImagesInArchive(QString(), archive->directory());
-    QCollator collator;
-    collator.setNumericMode(true);
-    std::sort(m_entries.begin(), m_entries.end(), collator);
-
-    Q_EMIT finishedMemory(archive, m_entries);
-    m_entries.clear();
+    return archive.release();
 }
 
-void Extractor::getImagesInArchive(const QString &prefix, const KArchiveDirectory *dir)
+void Extractor::getImagesInArchive(const QString &prefix, const KArchiveDirectory *dir, QStringList *entries)
 {
     const QStringList entryList = dir->entries();
     for (const QString &file : entryList) {
         const KArchiveEntry *e = dir->entry(file);
         if (e->isDirectory()) {
-            getImagesInArchive(prefix + file + QStringLiteral("/"), static_cast<const KArchiveDirectory *>(e));
+            getImagesInArchive(prefix + file + QStringLiteral("/"), static_cast<const KArchiveDirectory *>(e), entries);
         } else if (e->isFile()) {
-            m_entries.append(prefix + file);
+            entries->append(prefix + file);
         }
     }
 }
 
 void Extractor::extractRarArchive()
 {
-    delete m_tmpFolder;
-    m_tmpFolder = new QTemporaryDir();
+    // extracted before and not changed since, nothing to do
+    m_extractionFolder = ExtractionCache::folder(m_archiveFile);
+    if (ExtractionCache::use(m_extractionFolder)) {
+        Q_EMIT finished();
+        return;
+    }
+    ExtractionCache::discard(m_extractionFolder);
+    if (!QDir().mkpath(m_extractionFolder)) {
+        Q_EMIT error(i18n("Could not create folder: %1", m_extractionFolder));
+        return;
+    }
 
     auto unrar = MangaReaderSettings::unrarPath().isEmpty()
             ? MangaReaderSettings::autoUnrarPath()
@@ -120,25 +383,100 @@ void Extractor::extractRarArchive()
         Q_EMIT unrarNotFound();
     }
 
+    // list the archive first so the pages can be shown while they are extracted
+    auto process = new QProcess(this);
+    m_process = process;
+    process->setProgram(unrar);
+    process->setArguments({u"lb"_qs, m_archiveFile});
+    process->start();
+
+    connect(process, (void (QProcess::*)(int,QProcess::ExitStatus))&QProcess::finished,
+            this, [=](int exitCode, QProcess::ExitStatus exitStatus) {
+        m_process = nullptr;
+        process->deleteLater();
+
+        // "e" extracts without the archive's folders
+        QStringList files;
+        const QDir folder(m_extractionFolder);
+        const QStringList names = QString::fromUtf8(process->readAllStandardOutput()).split(QLatin1Char('\n'));
+        for (const QString &name : names) {
+            const QString fileName = QFileInfo(name.trimmed()).fileName();
+            if (!fileName.isEmpty()) {
+                files.append(folder.absoluteFilePath(fileName));
+            }
+        }
+        files.removeDuplicates();
+
+        const bool streaming = exitStatus == QProcess::NormalExit && exitCode == 0 && !files.isEmpty();
+        if (streaming) {
+            QCollator collator;
+            collator.setNumericMode(true);
+            std::sort(files.begin(), files.end(), collator);
+            Q_EMIT listed(m_extractionFolder, files);
+        }
+        startRarExtraction(unrar, streaming);
+    });
+    connectProcessErrors(process);
+}
+
+void Extractor::startRarExtraction(const QString &unrar, bool streaming)
+{
     QStringList args;
-    args << u"e"_qs << m_archiveFile << m_tmpFolder->path() << u"-o+"_qs;
-    auto process = new QProcess();
+    args << u"e"_qs << m_archiveFile << m_extractionFolder << u"-o+"_qs;
+    auto process = new QProcess(this);
+    m_process = process;
     process->setProgram(unrar);
     process->setArguments(args);
     process->start();
 
     connect(process, (void (QProcess::*)(int,QProcess::ExitStatus))&QProcess::finished,
-            this, &Extractor::finished);
+            this, [=](int exitCode, QProcess::ExitStatus exitStatus) {
+        m_process = nullptr;
+        process->deleteLater();
+        // failed extractions are extracted again the next time
+        if (exitStatus == QProcess::NormalExit && exitCode == 0) {
+            ExtractionCache::setComplete(m_extractionFolder);
+        }
+        ExtractionCache::prune(static_cast<qint64>(MangaReaderSettings::extractionCacheSize()) * 1024 * 1024,
+                               m_extractionFolder);
+        Q_EMIT finished();
+    });
 
+    // unrar prints a line per file, ending with OK once the file is written;
+    // the percentages in between are overwritten with backspaces
+    auto output = std::make_shared<QString>();
     connect(process, &QProcess::readyReadStandardOutput, this, [=]() {
+        const QString chunk = QString::fromUtf8(process->readAllStandardOutput());
         QRegularExpression re(u"[0-9]+[%]"_qs);
-        QRegularExpressionMatch match = re.match(QString::fromUtf8(process->readAllStandardOutput()));
+        QRegularExpressionMatch match = re.match(chunk);
         if (match.hasMatch()) {
             QString matched = match.captured(0);
             Q_EMIT progress(matched.remove(u"%"_qs).toInt());
         }
+        if (!streaming) {
+            return;
+        }
+
+        output->append(chunk);
+        static const QRegularExpression noise(u"\\x08+|[0-9]+%"_qs);
+        static const QRegularExpression extracted(u"^Extracting\\s+(.*\\S)\\s+OK$"_qs);
+        qsizetype end = 0;
+        while ((end = output->indexOf(QLatin1Char('\n'))) >= 0) {
+            QString line = output->left(end);
+            output->remove(0, end + 1);
+            line.remove(noise);
+            const QRegularExpressionMatch lineMatch = extracted.match(line.trimmed());
+            if (lineMatch.hasMatch()) {
+                const QString fileName = QFileInfo(lineMatch.captured(1)).fileName();
+                Q_EMIT fileExtracted(QDir(m_extractionFolder).absoluteFilePath(fileName));
+            }
+        }
     });
+    connectProcessErrors(process);
+}
 
+void Extractor::connectProcessErrors(QProcess *process)
+{
     connect(process, &QProcess::errorOccurred,
             this, [=](QProcess::ProcessError err) {
         QString errorMessage;
@@ -163,8 +501,6 @@ void Extractor::extractRarArchive()
         }
         Q_EMIT error(i18n("Error: Could not open the archive. %1", errorMessage));
     });
-
-    return;
 }
 
 const QString &Extractor::archiveFile() const
@@ -179,7 +515,7 @@ void Extractor::setArchiveFile(const QString &archiveFile)
 
 QString Extractor::extractionFolder()
 {
-    return m_tmpFolder->path();
+    return m_extractionFolder;
 }
 
 QString Extractor::unrarNotFoundMessage()
@@ -7,9 +7,17 @@
 #ifndef EXTRACTOR_H
 #define EXTRACTOR_H
 
+#include <QList>
 #include <QObject>
+#include <QSize>
 
-class QTemporaryDir;
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class QIODevice;
+class QProcess;
+class QThread;
 class KArchive;
 class KArchiveDirectory;
 
@@ -20,26 +28,50 @@ public:
     explicit Extractor(QObject *parent = nullptr);
     ~Extractor();
 
+    // set to true to stop opening an archive
+    using Token = std::shared_ptr<std::atomic_bool>;
+
+    // opens archiveFile on a separate thread, cancelling the archive that is still being opened
     void extractArchive();
+    void cancel();
     void extractRarArchive();
     QString extractionFolder();
     QString unrarNotFoundMessage();
     const QString &archiveFile() const;
     void setArchiveFile(const QString &archiveFile);
 
+    // returns an unopened archive for archiveFile, nullptr for unsupported types and, without libarchive, rar;
+    // when device is set the archive reads through it and doesn't take ownership of it
+    static auto createArchive(const QString &archiveFile, QIODevice *device = nullptr) -> KArchive *;
+    // returns the opened archive for archiveFile, nullptr when it can't be read
+    static auto openArchive(const QString &archiveFile, QIODevice *device = nullptr) -> KArchive *;
+
 Q_SIGNALS:
     void started();
     void finished();
-    void finishedMemory(KArchive *, const QStringList &);
+    // the files unrar is going to extract, in natural order, before it starts
+    void listed(const QString &folder, const QStringList &files);
+    // a file unrar finished writing
+    void fileExtracted(const QString &file);
+    // sizes has the page sizes known without probing, or is empty
+    void finishedMemory(KArchive *, const QStringList &, const std::vector<QSize> &sizes);
     void error(const QString &);
     void progress(int);
     void unrarNotFound();
 
 private:
-    void getImagesInArchive(const QString &prefix, const KArchiveDirectory *dir);
+    void startRarExtraction(const QString &unrar, bool streaming);
+    void connectProcessErrors(QProcess *process);
+    static void getImagesInArchive(const QString &prefix, const KArchiveDirectory *dir, QStringList *entries);
     QString  m_archiveFile;
-    QTemporaryDir *m_tmpFolder {};
-    QStringList m_entries;
+    // where rar archives are extracted to, kept in the extraction cache
+    QString m_extractionFolder;
+    QProcess *m_process {};
+    Token m_cancel;
+    // threads still opening archives, cancelled ones included
+    QList<QThread *> m_threads;
+    // the device the archive given to the view reads from
+    QIODevice *m_device {};
 };
 
 #endif // EXTRACTOR_H
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "grayscale.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GRAYSCALE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GRAYSCALE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// checks count pixels stored as 0xAARRGGBB
+auto isRowGrayscale(const QRgb *pixels, int count, int tolerance) -> bool
+{
+    int x = 0;
+#ifdef GRAYSCALE_SSE2
+    // per pixel: byte 0 |B - G|, byte 1 |G - R|, the alpha bytes are masked out
+    const __m128i mask = _mm_set1_epi32(0x0000ffff);
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(tolerance));
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 4 <= count; x += 4) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + x));
+        const __m128i b = _mm_srli_epi32(a, 8);
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        diff = _mm_subs_epu8(_mm_and_si128(diff, mask), limit);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) != 0xffff) {
+            return false;
+        }
+    }
+#elif defined(GRAYSCALE_NEON)
+    const uint8x16_t limit = vdupq_n_u8(static_cast<uint8_t>(tolerance));
+    for (; x + 16 <= count; x += 16) {
+        // deinterleaves 16 pixels into their B, G, R and A bytes
+        const uint8x16x4_t p = vld4q_u8(reinterpret_cast<const uint8_t *>(pixels + x));
+        const uint8x16_t diff = vmaxq_u8(vabdq_u8(p.val[0], p.val[1]), vabdq_u8(p.val[2], p.val[1]));
+        if (vmaxvq_u8(vqsubq_u8(diff, limit)) != 0) {
+            return false;
+        }
+    }
+#endif
+    for (; x < count; ++x) {
+        const int g = qGreen(pixels[x]);
+        if (std::abs(qRed(pixels[x]) - g) > tolerance || std::abs(qBlue(pixels[x]) - g) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+auto Grayscale::isGrayscale(const QImage &image, int tolerance) -> bool
+{
+    if (image.isNull() || image.format() != QImage::Format_RGB32) {
+        return false;
+    }
+    tolerance = std::clamp(tolerance, 0, 255);
+    for (int y = 0; y < image.height(); ++y) {
+        if (!isRowGrayscale(reinterpret_cast<const QRgb *>(image.constScanLine(y)), image.width(), tolerance)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto Grayscale::simplified(const QImage &image, int tolerance) -> QImage
+{
+    if (image.format() == QImage::Format_Grayscale8) {
+        return image;
+    }
+    if (image.format() == QImage::Format_Grayscale16) {
+        return image.convertToFormat(QImage::Format_Grayscale8);
+    }
+
+    QImage source = image;
+    if (!image.hasAlphaChannel() && image.format() != QImage::Format_RGB32) {
+        source = image.convertToFormat(QImage::Format_RGB32);
+    }
+    if (!isGrayscale(source, tolerance)) {
+        return image;
+    }
+
+    QImage result(source.size(), QImage::Format_Grayscale8);
+    if (result.isNull()) {
+        return image;
+    }
+    for (int y = 0; y < source.height(); ++y) {
+        auto in = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        uchar *out = result.scanLine(y);
+        for (int x = 0; x < source.width(); ++x) {
+            // channels are within tolerance of each other, a cheap weighted mean is enough
+            out[x] = static_cast<uchar>((qRed(in[x]) + 2 * qGreen(in[x]) + qBlue(in[x]) + 2) / 4);
+        }
+    }
+    result.setDotsPerMeterX(source.dotsPerMeterX());
+    result.setDotsPerMeterY(source.dotsPerMeterY());
+    return result;
+}
@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef GRAYSCALE_H
+#define GRAYSCALE_H
+
+#include <QImage>
+
+namespace Grayscale
+{
+
+// true when no pixel's red, green and blue differ by more than tolerance,
+// only Format_RGB32 images are checked
+auto isGrayscale(const QImage &image, int tolerance) -> bool;
+
+// returns image as Format_Grayscale8 when it has no visible color, otherwise image unchanged
+auto simplified(const QImage &image, int tolerance) -> QImage;
+
+} // namespace Grayscale
+
+#endif // GRAYSCALE_H
@@ -0,0 +1,422 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "libarchivereader.h"
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+
+#include "metadatacache.h"
+
+namespace
+{
+
+constexpr quint32 IndexVersion = 1;
+constexpr qint64 BufferSize = 64 * 1024;
+// decoded entries a session keeps, the probe and worker threads ask for entries around the same pages
+constexpr qint64 SessionCacheSize = 128 * 1024 * 1024;
+// entries passed on the way to the requested one are kept when they are this close to it,
+// farther ones are skipped (a solid archive decompresses them anyway, others can seek past them)
+constexpr qint64 KeptEntries = 64;
+
+// the device libarchive reads from
+struct Source {
+    QIODevice *device;
+    QByteArray buffer;
+};
+
+auto readSource(struct archive *reader, void *clientData, const void **buffer) -> la_ssize_t
+{
+    auto source = static_cast<Source *>(clientData);
+    const qint64 read = source->device->read(source->buffer.data(), source->buffer.size());
+    if (read < 0) {
+        archive_set_error(reader, EIO, "%s", qPrintable(source->device->errorString()));
+        return ARCHIVE_FATAL;
+    }
+    *buffer = source->buffer.constData();
+    return read;
+}
+
+auto seekSource(struct archive *reader, void *clientData, la_int64_t offset, int whence) -> la_int64_t
+{
+    Q_UNUSED(reader)
+    QIODevice *dev = static_cast<Source *>(clientData)->device;
+    qint64 position = offset;
+    if (whence == SEEK_CUR) {
+        position += dev->pos();
+    } else if (whence == SEEK_END) {
+        position += dev->size();
+    }
+    if (position < 0 || !dev->seek(position)) {
+        return ARCHIVE_FATAL;
+    }
+    return position;
+}
+
+auto skipSource(struct archive *reader, void *clientData, la_int64_t request) -> la_int64_t
+{
+    Q_UNUSED(reader)
+    QIODevice *dev = static_cast<Source *>(clientData)->device;
+    const qint64 skipped = std::min<qint64>(request, dev->size() - dev->pos());
+    if (skipped <= 0 || !dev->seek(dev->pos() + skipped)) {
+        return 0;
+    }
+    return skipped;
+}
+
+// reader positioned before the first entry, null and error set when the format isn't recognized
+auto openReader(Source *source, QString *error) -> struct archive *
+{
+    if (!source->device || !source->device->seek(0)) {
+        return nullptr;
+    }
+    source->buffer.resize(BufferSize);
+    struct archive *reader = archive_read_new();
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+    archive_read_set_read_callback(reader, &readSource);
+    archive_read_set_seek_callback(reader, &seekSource);
+    archive_read_set_skip_callback(reader, &skipSource);
+    archive_read_set_callback_data(reader, source);
+    if (archive_read_open1(reader) != ARCHIVE_OK) {
+        if (error) {
+            *error = QString::fromUtf8(archive_error_string(reader));
+        }
+        archive_read_free(reader);
+        return nullptr;
+    }
+    return reader;
+}
+
+// data of the entry whose header was read last
+auto readData(struct archive *reader, struct archive_entry *entry, QByteArray *data) -> bool
+{
+    if (entry && archive_entry_size_is_set(entry)) {
+        // the size comes from the header, append grows past it when it was too small
+        data->reserve(std::clamp<qint64>(archive_entry_size(entry), 0, SessionCacheSize));
+    }
+    QByteArray chunk(BufferSize, Qt::Uninitialized);
+    la_ssize_t read = 0;
+    while ((read = archive_read_data(reader, chunk.data(), chunk.size())) > 0) {
+        data->append(chunk.constData(), read);
+    }
+    return read == 0;
+}
+
+class LibArchiveFile : public KArchiveFile
+{
+public:
+    LibArchiveFile(LibArchiveReader *reader, const QString &name, int access, const QDateTime &date, qint64 index, qint64 size)
+        : KArchiveFile(reader, name, access, date, QString(), QString(), QString(), index, size)
+        , m_reader{reader}
+    {
+    }
+
+    auto data() const -> QByteArray override
+    {
+        return m_reader->entryData(position());
+    }
+
+    auto createDevice() const -> QIODevice * override
+    {
+        auto buffer = new QBuffer();
+        buffer->setData(data());
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+
+private:
+    LibArchiveReader *m_reader;
+};
+
+} // namespace
+
+// the view, the probe threads and every worker open their own reader of the archive;
+// they share one session so a solid archive isn't decompressed from the start by each of them.
+// Decoding holds the session's lock, threads reading the same archive take turns even when
+// its entries could be decompressed on their own; libarchive doesn't tell solid archives apart
+class LibArchiveReader::Session
+{
+public:
+    explicit Session(const QString &path)
+        : m_file(path)
+    {
+        m_source.device = &m_file;
+    }
+
+    ~Session()
+    {
+        close();
+    }
+
+    // the session of path, a new one when no reader of path is open
+    static auto get(const QString &path) -> std::shared_ptr<Session>
+    {
+        static QMutex mutex;
+        static QHash<QString, std::weak_ptr<Session>> sessions;
+        QMutexLocker locker(&mutex);
+        std::shared_ptr<Session> session = sessions.value(path).lock();
+        if (!session) {
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                it = it->expired() ? sessions.erase(it) : std::next(it);
+            }
+            session = std::make_shared<Session>(path);
+            sessions.insert(path, session);
+        }
+        return session;
+    }
+
+    auto entryData(qint64 index) -> QByteArray
+    {
+        QMutexLocker locker(&m_mutex);
+        if (index < 0) {
+            return {};
+        }
+        if (auto it = m_cache.constFind(index); it != m_cache.cend()) {
+            return *it;
+        }
+
+        // entries can only be read front to back, the data of the last one was read already
+        if (!m_reader || index <= m_index) {
+            close();
+            if (!open()) {
+                return {};
+            }
+        }
+
+        struct archive_entry *entry = nullptr;
+        while (m_index < index) {
+            if (archive_read_next_header(m_reader, &entry) != ARCHIVE_OK) {
+                close();
+                return {};
+            }
+            ++m_index;
+            if (m_index < index && index - m_index <= KeptEntries
+                    && archive_entry_filetype(entry) == AE_IFREG && !m_cache.contains(m_index)) {
+                QByteArray data;
+                if (!readData(m_reader, entry, &data)) {
+                    close();
+                    return {};
+                }
+                keep(m_index, data);
+            }
+        }
+
+        QByteArray data;
+        if (!readData(m_reader, entry, &data)) {
+            close();
+            return {};
+        }
+        keep(index, data);
+        return data;
+    }
+
+private:
+    auto open() -> bool
+    {
+        if (!m_file.isOpen() && !m_file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        m_reader = openReader(&m_source, nullptr);
+        m_index = -1;
+        return m_reader;
+    }
+
+    void close()
+    {
+        if (m_reader) {
+            archive_read_free(m_reader);
+            m_reader = nullptr;
+        }
+        m_index = -1;
+    }
+
+    // the oldest entries are dropped first
+    void keep(qint64 index, const QByteArray &data)
+    {
+        m_cache.insert(index, data);
+        m_order.push_back(index);
+        m_cacheSize += data.size();
+        while (m_cacheSize > SessionCacheSize && m_order.size() > 1) {
+            m_cacheSize -= m_cache.take(m_order.front()).size();
+            m_order.pop_front();
+        }
+    }
+
+    QMutex m_mutex;
+    QFile m_file;
+    Source m_source{};
+    struct archive *m_reader{};
+    // position of the entry whose header was read last
+    qint64 m_index{-1};
+    QHash<qint64, QByteArray> m_cache;
+    std::deque<qint64> m_order;
+    qint64 m_cacheSize{0};
+};
+
+LibArchiveReader::LibArchiveReader(const QString &fileName)
+    : KArchive(fileName)
+    , m_path{fileName}
+{
+}
+
+LibArchiveReader::LibArchiveReader(QIODevice *dev, const QString &path)
+    : KArchive(dev)
+    , m_path{path}
+{
+}
+
+LibArchiveReader::~LibArchiveReader()
+{
+    if (isOpen()) {
+        close();
+    }
+}
+
+auto LibArchiveReader::openArchive(QIODevice::OpenMode mode) -> bool
+{
+    if (mode != QIODevice::ReadOnly) {
+        return false;
+    }
+
+    // the headers are only read the first time the file is opened
+    QByteArray index;
+    if (!MetadataCache::loadIndex(m_path, &index) || !readIndex(index)) {
+        if (!listEntries()) {
+            m_entries.clear();
+            return false;
+        }
+        MetadataCache::saveIndex(m_path, writeIndex());
+    }
+
+    for (const Entry &entry : std::as_const(m_entries)) {
+        const int slash = entry.path.lastIndexOf(QLatin1Char('/'));
+        KArchiveDirectory *parent = slash < 0 ? rootDir() : findOrCreate(entry.path.left(slash));
+        auto file = new LibArchiveFile(this, entry.path.mid(slash + 1), entry.access,
+                                       QDateTime::fromSecsSinceEpoch(entry.mtime), entry.index, entry.size);
+        if (!parent->addEntryV2(file)) {
+            delete file;
+        }
+    }
+    m_session = Session::get(m_path);
+    return true;
+}
+
+auto LibArchiveReader::closeArchive() -> bool
+{
+    m_entries.clear();
+    m_session.reset();
+    return true;
+}
+
+auto LibArchiveReader::entryData(qint64 index) -> QByteArray
+{
+    return m_session ? m_session->entryData(index) : QByteArray();
+}
+
+auto LibArchiveReader::listEntries() -> bool
+{
+    Source source{device(), {}};
+    QString error;
+    struct archive *reader = openReader(&source, &error);
+    if (!reader) {
+        setErrorString(error);
+        return false;
+    }
+
+    // only the headers are read, the data of every entry is skipped
+    struct archive_entry *entry = nullptr;
+    qint64 index = -1;
+    int result = ARCHIVE_OK;
+    while ((result = archive_read_next_header(reader, &entry)) == ARCHIVE_OK) {
+        ++index;
+        if (archive_entry_filetype(entry) != AE_IFREG) {
+            continue;
+        }
+        const char *utf8 = archive_entry_pathname_utf8(entry);
+        m_entries.push_back({utf8 ? QString::fromUtf8(utf8) : QString::fromLocal8Bit(archive_entry_pathname(entry)),
+                             index, archive_entry_size(entry), static_cast<qint32>(archive_entry_perm(entry)),
+                             static_cast<qint64>(archive_entry_mtime(entry))});
+    }
+    if (result != ARCHIVE_EOF) {
+        setErrorString(QString::fromUtf8(archive_error_string(reader)));
+    }
+    archive_read_free(reader);
+    return result == ARCHIVE_EOF;
+}
+
+auto LibArchiveReader::readIndex(const QByteArray &index) -> bool
+{
+    QDataStream in(index);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> version >> count;
+    // the count comes from the file, every entry takes at least a byte
+    if (in.status() != QDataStream::Ok || version != IndexVersion || count > static_cast<quint32>(index.size())) {
+        return false;
+    }
+    m_entries.resize(count);
+    for (Entry &entry : m_entries) {
+        in >> entry.path >> entry.index >> entry.size >> entry.access >> entry.mtime;
+    }
+    if (in.status() != QDataStream::Ok) {
+        m_entries.clear();
+        return false;
+    }
+    return true;
+}
+
+auto LibArchiveReader::writeIndex() const -> QByteArray
+{
+    QByteArray index;
+    QDataStream out(&index, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << IndexVersion << static_cast<quint32>(m_entries.size());
+    for (const Entry &entry : m_entries) {
+        out << entry.path << entry.index << entry.size << entry.access << entry.mtime;
+    }
+    return index;
+}
+
+// read only
+
+auto LibArchiveReader::doWriteDir(const QString &, const QString &, const QString &,
+                                  mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto LibArchiveReader::doWriteSymLink(const QString &, const QString &, const QString &, const QString &,
+                                      mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto LibArchiveReader::doPrepareWriting(const QString &, const QString &, const QString &, qint64,
+                                        mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto LibArchiveReader::doFinishWriting(qint64) -> bool
+{
+    return false;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LIBARCHIVEREADER_H
+#define LIBARCHIVEREADER_H
+
+#include <KArchive>
+
+#include <QByteArray>
+
+#include <memory>
+#include <vector>
+
+// read only KArchive for the formats KArchive can't read (rar) or reads
+// into memory when opening (7z); only the entry headers are read the first time the file is opened,
+// that list is kept in the metadata cache. An entry is decompressed when its data is requested
+class LibArchiveReader : public KArchive
+{
+public:
+    struct Entry {
+        QString path;
+        // order of the entry in the archive, directories included
+        qint64 index;
+        qint64 size;
+        qint32 access;
+        qint64 mtime;
+    };
+
+    explicit LibArchiveReader(const QString &fileName);
+    // path is the archive file the entry list is stored for and the entries are read from
+    LibArchiveReader(QIODevice *dev, const QString &path);
+    ~LibArchiveReader() override;
+
+    // decompresses the entry with the given position, the order of the entry in the archive;
+    // every reader of the same file shares one decoder, see Session
+    auto entryData(qint64 index) -> QByteArray;
+
+protected:
+    auto openArchive(QIODevice::OpenMode mode) -> bool override;
+    auto closeArchive() -> bool override;
+    auto doWriteDir(const QString &name, const QString &user, const QString &group,
+                    mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doWriteSymLink(const QString &name, const QString &target, const QString &user, const QString &group,
+                        mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doPrepareWriting(const QString &name, const QString &user, const QString &group, qint64 size,
+                          mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doFinishWriting(qint64 size) -> bool override;
+
+private:
+    // decompresses the entries of one file front to back
+    class Session;
+
+    auto listEntries() -> bool;
+    auto readIndex(const QByteArray &index) -> bool;
+    auto writeIndex() const -> QByteArray;
+
+    QString m_path;
+    std::vector<Entry> m_entries;
+    std::shared_ptr<Session> m_session;
+};
+
+#endif // LIBARCHIVEREADER_H
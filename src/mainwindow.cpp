@@ -11,6 +11,7 @@
 #include <QComboBox>
 #include <QDesktopServices>
 #include <QDockWidget>
+#include <QFile>
 #include <QFileDialog>
 #include <QFileSystemModel>
 #include <QHeaderView>
@@ -25,7 +26,6 @@
 #include <QSpinBox>
 #include <QStandardItemModel>
 #include <QTableView>
-#include <QThread>
 #include <QTreeView>
 #include <QVBoxLayout>
 
@@ -46,7 +46,9 @@
 #include <KLocalizedString>
 #include <KToolBar>
 
+#include "comicinfo.h"
 #include "extractor.h"
+#include "metadatacache.h"
 #include "settings.h"
 #include "settingswindow.h"
 #include "startupwidget.h"
@@ -88,8 +90,7 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
-    m_thread->quit();
-    m_thread->wait();
+    Worker::instance()->stop();
 }
 
 void MainWindow::init()
@@ -108,11 +109,21 @@ void MainWindow::init()
     });
     connect(m_extractor, &Extractor::finished, this, [=]() {
         m_progressBar->setVisible(false);
+        // already shown while it was extracted
+        if (m_view->isExtracting() && m_view->manga() == m_extractor->extractionFolder()) {
+            m_view->extractionFinished();
+            return;
+        }
         loadImages(m_extractor->extractionFolder(), true);
     });
+    connect(m_extractor, &Extractor::listed,
+            this, &MainWindow::loadExtractingImages);
+    connect(m_extractor, &Extractor::fileExtracted,
+            m_view, &View::fileExtracted);
     connect(m_extractor, &Extractor::finishedMemory,
             this, &MainWindow::loadImagesFromMemory);
     connect(m_extractor, &Extractor::error, this, [=](const QString &error) {
+        m_progressBar->setVisible(false);
         showError(error);
     });
     connect(m_extractor, &Extractor::unrarNotFound, this, [=]() {
@@ -181,15 +192,11 @@ void MainWindow::init()
     centralWidgetLayout->addWidget(m_view);
 
     // ==================================================
-    // setup thread and worker
+    // setup worker threads
     // ==================================================
-    m_thread = new QThread(this);
-    Worker::instance()->moveToThread(m_thread);
-//    connect(m_thread, &QThread::finished,
-//            Worker::instance(), &Worker::deleteLater);
-    connect(m_thread, &QThread::finished,
-            m_thread, &QThread::deleteLater);
-    m_thread->start();
+    Worker::instance()->setResizeFilter(static_cast<Resampler::Filter>(MangaReaderSettings::filterQuality()));
+    Worker::instance()->setDetectGrayscale(MangaReaderSettings::detectGrayscale());
+    Worker::instance()->start(MangaReaderSettings::decodeThreads());
 
     // ==================================================
     // setup KHamburgerMenu
@@ -225,7 +232,9 @@ void MainWindow::setupMangaTreeDockWidget()
     m_treeModel->setNameFilters(QStringList() << u"*.zip"_qs << u"*.cbz"_qs
                                               << u"*.rar"_qs << u"*.cbr"_qs
                                               << u"*.7z"_qs  << u"*.cb7"_qs
-                                              << u"*.tar"_qs << u"*.cbt"_qs);
+                                              << u"*.tar"_qs << u"*.cbt"_qs
+                                              << u"*.tar.gz"_qs << u"*.tgz"_qs << u"*.cbt.gz"_qs
+                                              << u"*.tar.xz"_qs << u"*.txz"_qs << u"*.cbt.xz"_qs);
     m_treeModel->setNameFilterDisables(false);
 
     m_treeView->setModel(m_treeModel);
@@ -424,7 +433,8 @@ void MainWindow::openMangaArchive()
                 this,
                 i18n("Open Archive"),
                 QDir::homePath(),
-                i18n("Archives (*.zip *.rar *.7z *.tar *.cbz *.cbr *.cb7 *.cbt)"));
+                i18n("Archives (*.zip *.rar *.7z *.tar *.cbz *.cbr *.cb7 *.cbt "
+                     "*.tar.gz *.tgz *.cbt.gz *.tar.xz *.txz *.cbt.xz)"));
     if (file.isEmpty()) {
         return;
     }
@@ -502,7 +512,7 @@ void MainWindow::loadImages(const QString &path, bool recursive)
     if (!m_supportedMimeTypes.contains(mimetype)) {
         showError(i18n("Unsuported file type: %1\n"
                        "Only folders and .zip, .cbz, .rar, .cbr, "
-                       ".7z, .cb7, .tar, .cbt archives are supported. ", mimetype));
+                       ".7z, .cb7, .tar, .cbt and gzip or xz compressed tar archives are supported. ", mimetype));
         return;
     }
 
@@ -516,26 +526,42 @@ void MainWindow::loadImages(const QString &path, bool recursive)
         m_extractor->extractArchive();
         return;
     }
+    // an archive that is still being opened would replace this folder
+    m_extractor->cancel();
 
     m_files.clear();
 
-    // get images from path
-    QDirIterator::IteratorFlags flags = recursive
-        ? QDirIterator::Subdirectories
-        : QDirIterator::NoIteratorFlags;
-    QDirIterator it(mangaPath, QDir::Files, flags);
-    while (it.hasNext()) {
-        QString file = it.next();
-        mimetype = db.mimeTypeForFile(file).name();
-        // only get images
-        if (mimetype.startsWith(u"image/"_qs)) {
-            m_files.append(file);
+    // adding or removing files changes the folder's modification time, which
+    // invalidates the cached list; that doesn't hold for subfolders
+    MangaMetadata metadata;
+    std::vector<QSize> sizes;
+    if (!recursive && MetadataCache::load(mangaPath, &metadata)) {
+        m_files = metadata.files;
+    } else {
+        // get images from path
+        QDirIterator::IteratorFlags flags = recursive
+            ? QDirIterator::Subdirectories
+            : QDirIterator::NoIteratorFlags;
+        QDirIterator it(mangaPath, QDir::Files, flags);
+        while (it.hasNext()) {
+            QString file = it.next();
+            mimetype = db.mimeTypeForFile(file).name();
+            // only get images
+            if (mimetype.startsWith(u"image/"_qs)) {
+                m_files.append(file);
+            }
+        }
+        // natural sort images
+        QCollator collator;
+        collator.setNumericMode(true);
+        std::sort(m_files.begin(), m_files.end(), collator);
+
+        // extracted comic book archives keep their metadata next to the images
+        QFile comicInfo(mangaPath + QLatin1Char('/') + ComicInfo::FileName);
+        if (comicInfo.open(QIODevice::ReadOnly)) {
+            sizes = ComicInfo::applyPages(comicInfo.readAll(), &m_files);
         }
     }
-    // natural sort images
-    QCollator collator;
-    collator.setNumericMode(true);
-    std::sort(m_files.begin(), m_files.end(), collator);
 
     if (m_files.count() < 1) {
         return;
@@ -550,13 +576,15 @@ void MainWindow::loadImages(const QString &path, bool recursive)
     m_view->reset();
     m_view->setStartPage(m_startPage);
     m_view->setManga(mangaPath);
+    m_view->setRecursive(recursive);
     m_view->setFiles(m_files);
+    m_view->setPageSizes(sizes);
     m_view->setLoadFromMemory(false);
     m_view->loadImages();
     m_startPage = 0;
 }
 
-void MainWindow::loadImagesFromMemory(KArchive *archive, const QStringList &files)
+void MainWindow::loadImagesFromMemory(KArchive *archive, const QStringList &files, const std::vector<QSize> &sizes)
 {
     m_progressBar->setVisible(false);
     m_startUpWidget->setVisible(false);
@@ -570,13 +598,50 @@ void MainWindow::loadImagesFromMemory(KArchive *archive, const QStringList &file
     m_view->reset();
     m_view->setStartPage(m_startPage);
     m_view->setManga(fileInfo.absoluteFilePath());
+    m_view->setRecursive(false);
     m_view->setFiles(files);
+    m_view->setPageSizes(sizes);
     m_view->setArchive(archive);
     m_view->setLoadFromMemory(true);
     m_view->loadImages();
     m_startPage = 0;
 }
 
+void MainWindow::loadExtractingImages(const QString &folder, const QStringList &files)
+{
+    // the files don't exist yet, only their names tell if they are images
+    QMimeDatabase db;
+    m_files.clear();
+    for (const QString &file : files) {
+        if (db.mimeTypeForFile(file, QMimeDatabase::MatchExtension).name().startsWith(u"image/"_qs)) {
+            m_files.append(file);
+        }
+    }
+    if (m_files.isEmpty()) {
+        return;
+    }
+
+    m_isLoadedRecursive = true;
+    m_startUpWidget->setVisible(false);
+    m_view->setVisible(true);
+
+    actionCollection()->action(u"focusView"_qs)->trigger();
+
+    const QFileInfo fileInfo(m_extractor->archiveFile());
+    setWindowTitle(fileInfo.fileName());
+
+    m_view->reset();
+    m_view->setStartPage(m_startPage);
+    m_view->setManga(folder);
+    m_view->setRecursive(true);
+    m_view->setFiles(m_files);
+    m_view->setPageSizes({});
+    m_view->setLoadFromMemory(false);
+    m_view->setExtracting(true);
+    m_view->loadImages();
+    m_startPage = 0;
+}
+
 void MainWindow::setupActions()
 {
     auto *schemes = new KColorSchemeManager(this);
@@ -1148,6 +1213,9 @@ void MainWindow::openSettings()
             m_config->group(QString()).deleteEntry("Manga Folder");
         }
         populateLibrarySelectionComboBox();
+        Worker::instance()->setResizeFilter(static_cast<Resampler::Filter>(MangaReaderSettings::filterQuality()));
+        Worker::instance()->setDetectGrayscale(MangaReaderSettings::detectGrayscale());
+        Worker::instance()->setThreadCount(MangaReaderSettings::decodeThreads());
     });
     m_settingsWindow->show();
 }
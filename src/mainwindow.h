@@ -10,6 +10,8 @@
 #include <KSharedConfig>
 #include <KXmlGuiWindow>
 
+#include <vector>
+
 class QComboBox;
 class KArchive;
 class Extractor;
@@ -46,7 +48,8 @@ public:
     };
 
     void loadImages(const QString &path, bool recursive = false);
-    void loadImagesFromMemory(KArchive *archive, const QStringList &files);
+    void loadImagesFromMemory(KArchive *archive, const QStringList &files, const std::vector<QSize> &sizes);
+    void loadExtractingImages(const QString &folder, const QStringList &files);
 
     void setCurrentPath(const QString &_currentPath);
 
@@ -91,7 +94,6 @@ private:
     QDockWidget        *m_bookmarksDock{};
     QTableView         *m_bookmarksView{};
     QStandardItemModel *m_bookmarksModel{};
-    QThread            *m_thread{};
     QProgressBar       *m_progressBar{};
     QString             m_currentPath;
     QComboBox          *m_selectMangaLibraryComboBox{};
@@ -108,6 +110,11 @@ private:
                                              u"application/x-cb7"_qs,
                                              u"application/x-tar"_qs,
                                              u"application/x-cbt"_qs,
+                                             u"application/x-compressed-tar"_qs,
+                                             u"application/x-xz-compressed-tar"_qs,
+                                             // .cbt.gz and .cbt.xz have no mime type of their own
+                                             u"application/gzip"_qs,
+                                             u"application/x-xz"_qs,
                                              u"application/x-rar"_qs,
                                              u"application/x-cbr"_qs,
                                              u"application/vnd.rar"_qs,
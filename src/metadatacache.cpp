@@ -0,0 +1,192 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "metadatacache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <functional>
+
+namespace
+{
+
+constexpr quint32 Magic = 0x4d524d43; // MRMC
+constexpr quint32 Version = 2;
+// oldest files are removed when there are more
+constexpr int MaxEntries = 1000;
+
+auto cacheFolder(const QString &name) -> QString
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1Char('/') + name;
+}
+
+auto cacheFile(const QString &folder, const QString &path) -> QString
+{
+    const QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return folder + QLatin1Char('/') + QString::fromLatin1(hash);
+}
+
+void prune(const QDir &dir)
+{
+    const QFileInfoList entries = dir.entryInfoList(QDir::Files, QDir::Time);
+    for (int i = MaxEntries; i < entries.count(); i++) {
+        QFile::remove(entries.at(i).absoluteFilePath());
+    }
+}
+
+// the count comes from the file, every value takes at least a byte of its size
+template<typename T>
+auto readVector(QDataStream &in, std::vector<T> &values, qint64 fileSize) -> bool
+{
+    quint32 count = 0;
+    in >> count;
+    if (in.status() != QDataStream::Ok || count > fileSize) {
+        return false;
+    }
+    values.resize(count);
+    for (T &value : values) {
+        in >> value;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+template<typename T>
+void writeVector(QDataStream &out, const std::vector<T> &values)
+{
+    out << static_cast<quint32>(values.size());
+    for (const T &value : values) {
+        out << value;
+    }
+}
+
+// what a file is stored under, recursively loaded folders list their subfolders' files too
+auto cacheKey(const QFileInfo &fi, bool recursive) -> QString
+{
+    return recursive ? fi.absoluteFilePath() + QStringLiteral("/**") : fi.absoluteFilePath();
+}
+
+// opens the file stored for fi in folder, positioned after the header;
+// fails when the header doesn't match fi (a different path with the same hash, or the file was changed)
+auto openCacheFile(const QString &folder, const QFileInfo &fi, bool recursive, QFile *file, QDataStream *in) -> bool
+{
+    if (!fi.exists()) {
+        return false;
+    }
+    const QString key = cacheKey(fi, recursive);
+    file->setFileName(cacheFile(folder, key));
+    if (!file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    in->setDevice(file);
+    in->setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString storedPath;
+    qint64 size = 0;
+    qint64 modified = 0;
+    *in >> magic >> version;
+    if (magic != Magic || version != Version) {
+        return false;
+    }
+    *in >> storedPath >> size >> modified;
+    return in->status() == QDataStream::Ok && storedPath == key && size == fi.size()
+            && modified == fi.lastModified().toMSecsSinceEpoch();
+}
+
+// writes the header for fi, write calls write the rest
+void saveCacheFile(const QString &folder, const QFileInfo &fi, bool recursive,
+                   const std::function<void(QDataStream &)> &write)
+{
+    if (!fi.exists()) {
+        return;
+    }
+    const QDir dir(folder);
+    if (!dir.exists() && !dir.mkpath(QStringLiteral("."))) {
+        return;
+    }
+
+    const QString key = cacheKey(fi, recursive);
+    QSaveFile file(cacheFile(folder, key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << Magic << Version;
+    out << key << fi.size() << fi.lastModified().toMSecsSinceEpoch();
+    write(out);
+    if (file.commit()) {
+        prune(dir);
+    }
+}
+
+} // namespace
+
+namespace MetadataCache
+{
+
+auto load(const QString &path, MangaMetadata *metadata, bool recursive) -> bool
+{
+    QFile file;
+    QDataStream in;
+    if (!openCacheFile(cacheFolder(QStringLiteral("metadata")), QFileInfo(path), recursive, &file, &in)) {
+        return false;
+    }
+
+    MangaMetadata result;
+    in >> result.files;
+    if (!readVector(in, result.sizes, file.size()) || !readVector(in, result.offsets, file.size())) {
+        return false;
+    }
+    const auto count = static_cast<size_t>(result.files.count());
+    if ((!result.sizes.empty() && result.sizes.size() != count)
+            || (!result.offsets.empty() && result.offsets.size() != count)) {
+        return false;
+    }
+    *metadata = std::move(result);
+    return true;
+}
+
+void save(const QString &path, const MangaMetadata &metadata, bool recursive)
+{
+    saveCacheFile(cacheFolder(QStringLiteral("metadata")), QFileInfo(path), recursive, [&](QDataStream &out) {
+        out << metadata.files;
+        writeVector(out, metadata.sizes);
+        writeVector(out, metadata.offsets);
+    });
+}
+
+auto loadIndex(const QString &path, QByteArray *index) -> bool
+{
+    QFile file;
+    QDataStream in;
+    if (!openCacheFile(cacheFolder(QStringLiteral("index")), QFileInfo(path), false, &file, &in)) {
+        return false;
+    }
+    QByteArray result;
+    in >> result;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    *index = std::move(result);
+    return true;
+}
+
+void saveIndex(const QString &path, const QByteArray &index)
+{
+    saveCacheFile(cacheFolder(QStringLiteral("index")), QFileInfo(path), false, [&](QDataStream &out) {
+        out << index;
+    });
+}
+
+} // namespace MetadataCache
@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include <QByteArray>
+#include <QSize>
+#include <QStringList>
+
+#include <vector>
+
+// what is learned about a manga (folder or archive) when it is opened,
+// one entry per file in the sorted file list
+struct MangaMetadata {
+    QStringList files;
+    // empty until every page was probed, with the exif orientation applied
+    std::vector<QSize> sizes;
+    // position of the entries in the archive, empty for folders
+    std::vector<qint64> offsets;
+};
+
+namespace MetadataCache
+{
+
+// reads the metadata stored for path, fails when path changed (size or modification time) since it was stored;
+// a folder loaded with its subfolders is stored apart from the folder alone
+auto load(const QString &path, MangaMetadata *metadata, bool recursive = false) -> bool;
+
+// stores metadata for path under QStandardPaths::CacheLocation
+void save(const QString &path, const MangaMetadata &metadata, bool recursive = false);
+
+// an archive reader's own index of path (e.g. seek points), kept apart from the metadata
+// and dropped the same way when path changes
+auto loadIndex(const QString &path, QByteArray *index) -> bool;
+void saveIndex(const QString &path, const QByteArray &index);
+
+} // namespace MetadataCache
+
+#endif // METADATACACHE_H
@@ -9,53 +9,29 @@
 
 #include <QGraphicsItem>
 
-class QPixmap;
 class View;
 
+// draws the cached image of one page, the view keeps a small pool of these
+// and binds them to the pages near the viewport
 class Page : public QGraphicsItem
 {
 public:
-    Page(QSize sourceSize, QGraphicsItem *parent = nullptr);
-    ~Page();
-    void setView(View *view);
-    void setMaxWidth(int maxWidth);
-    const QImage &image() const;
-    void setImage(const QImage &image);
-    void redrawImage();
-    void calculateScaledSize();
-    void redraw(const QImage &image);
-    void deleteImage();
-    void setScaledSize(QSize size);
-    auto scaledSize() -> QSize;
-    auto sourceSize() -> QSize;
-    auto isImageDeleted() const -> bool;
-    auto zoom() const -> double;
-    void setZoom(double zoom);
-
-    bool isZoomToggled() const;
-    void setIsZoomToggled(bool isZoomToggled);
-
-    auto number() -> int;
-    void setNumber(int newNumber);
-
-    const QString &filename() const;
-    void setFilename(const QString &newFilename);
+    explicit Page(View *view, QGraphicsItem *parent = nullptr);
+
+    auto number() const -> int;
+    void setNumber(int number);
+    void setSize(const QSize &size);
+
+    // draws image and its border with the top left corner of the image at 0,0
+    static void paintImage(QPainter *painter, const QImage &image, const QRectF &exposedRect);
 
 private:
     auto boundingRect() const -> QRectF override;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
     View    *m_view{};
-    QSize    m_scaledSize;
-    QSize    m_sourceSize;
-    int      m_maxWidth{-1};
     int      m_number{-1};
-    double   m_zoom{1.0};
-    bool     m_isZoomToggled{false};
-    double   m_ratio{1.0};
-    QPixmap  m_pixmap;
-    QImage   m_image;
-    QString  m_filename;
+    QSize    m_size{0, 0};
 };
 
 #endif // PAGE_H
@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pagecache.h"
+
+PageCache::PageCache(QObject *parent)
+    : QObject{parent}
+{
+}
+
+void PageCache::setBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    evict();
+}
+
+auto PageCache::budget() const -> qint64
+{
+    return m_budget;
+}
+
+auto PageCache::size() const -> qint64
+{
+    return m_size;
+}
+
+void PageCache::setVisibleRange(int first, int last)
+{
+    m_firstVisible = first;
+    m_lastVisible = last;
+}
+
+auto PageCache::data(int number) const -> QByteArray
+{
+    auto it = m_entries.find(number);
+    if (it == m_entries.end()) {
+        return {};
+    }
+    it->lastUsed = ++m_clock;
+    return it->data;
+}
+
+auto PageCache::image(int number) const -> QImage
+{
+    auto it = m_entries.find(number);
+    if (it == m_entries.end()) {
+        return {};
+    }
+    it->lastUsed = ++m_clock;
+    return it->image;
+}
+
+auto PageCache::scaled(int number) const -> QImage
+{
+    auto it = m_entries.find(number);
+    if (it == m_entries.end()) {
+        return {};
+    }
+    it->lastUsed = ++m_clock;
+    return it->scaled;
+}
+
+auto PageCache::hasScaled(int number) const -> bool
+{
+    auto it = m_entries.constFind(number);
+    return it != m_entries.constEnd() && !it->scaled.isNull();
+}
+
+auto PageCache::bytes(int number) const -> qint64
+{
+    auto it = m_entries.constFind(number);
+    if (it == m_entries.constEnd()) {
+        return 0;
+    }
+    return tierBytes(*it, Scaled) + tierBytes(*it, Source) + tierBytes(*it, Compressed);
+}
+
+auto PageCache::bytes(int number, Tier tier) const -> qint64
+{
+    auto it = m_entries.constFind(number);
+    if (it == m_entries.constEnd()) {
+        return 0;
+    }
+    return tierBytes(*it, tier);
+}
+
+void PageCache::insertData(int number, const QByteArray &data)
+{
+    Entry &entry = m_entries[number];
+    m_size += data.size() - tierBytes(entry, Compressed);
+    entry.data = data;
+    touch(number);
+    evict();
+}
+
+void PageCache::insertImage(int number, const QImage &image)
+{
+    Entry &entry = m_entries[number];
+    m_size += image.sizeInBytes() - tierBytes(entry, Source);
+    entry.image = image;
+    touch(number);
+    evict();
+}
+
+void PageCache::insertScaled(int number, const QImage &image)
+{
+    Entry &entry = m_entries[number];
+    m_size += image.sizeInBytes() - tierBytes(entry, Scaled);
+    entry.scaled = image;
+    touch(number);
+    evict();
+}
+
+void PageCache::remove(int number, Tier tier)
+{
+    auto it = m_entries.find(number);
+    if (it == m_entries.end()) {
+        return;
+    }
+    m_size -= tierBytes(*it, tier);
+    switch (tier) {
+    case Scaled:
+        it->scaled = QImage();
+        break;
+    case Source:
+        it->image = QImage();
+        break;
+    case Compressed:
+        it->data = QByteArray();
+        break;
+    }
+    if (it->scaled.isNull() && it->image.isNull() && it->data.isEmpty()) {
+        m_entries.erase(it);
+    }
+}
+
+void PageCache::remove(int number)
+{
+    m_size -= bytes(number);
+    m_entries.remove(number);
+}
+
+void PageCache::clear()
+{
+    m_entries.clear();
+    m_size = 0;
+}
+
+auto PageCache::tierBytes(const Entry &entry, Tier tier) -> qint64
+{
+    switch (tier) {
+    case Scaled:
+        return entry.scaled.sizeInBytes();
+    case Source:
+        return entry.image.sizeInBytes();
+    case Compressed:
+        return entry.data.size();
+    }
+    return 0;
+}
+
+auto PageCache::distance(int number) const -> int
+{
+    // before the first visible range every page can be evicted, the least recently used first
+    if (m_firstVisible < 0) {
+        return 1;
+    }
+    if (number < m_firstVisible) {
+        return m_firstVisible - number;
+    }
+    if (number > m_lastVisible) {
+        return number - m_lastVisible;
+    }
+    return 0;
+}
+
+void PageCache::touch(int number)
+{
+    m_entries[number].lastUsed = ++m_clock;
+}
+
+void PageCache::evict()
+{
+    while (m_size > m_budget) {
+        // the page furthest from the viewport goes first, the least recently used one on ties,
+        // visible pages are never evicted
+        auto victim = m_entries.end();
+        int victimDistance = 0;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            const int d = distance(it.key());
+            if (d == 0) {
+                continue;
+            }
+            if (victim == m_entries.end() || d > victimDistance
+                    || (d == victimDistance && it->lastUsed < victim->lastUsed)) {
+                victim = it;
+                victimDistance = d;
+            }
+        }
+        if (victim == m_entries.end()) {
+            return;
+        }
+
+        // drop the tier that is cheapest to re-create first
+        const int number = victim.key();
+        Tier tier = Compressed;
+        if (!victim->scaled.isNull()) {
+            tier = Scaled;
+        } else if (!victim->image.isNull()) {
+            tier = Source;
+        }
+        remove(number, tier);
+        Q_EMIT evicted(number, tier);
+    }
+}
+
+#include "moc_pagecache.cpp"
@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+
+class PageCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PageCache(QObject *parent = nullptr);
+
+    // ordered from the cheapest to re-create to the most expensive
+    enum Tier {
+        Scaled,
+        Source,
+        Compressed
+    };
+
+    void setBudget(qint64 bytes);
+    auto budget() const -> qint64;
+    auto size() const -> qint64;
+    void setVisibleRange(int first, int last);
+
+    auto data(int number) const -> QByteArray;
+    auto image(int number) const -> QImage;
+    auto scaled(int number) const -> QImage;
+    auto hasScaled(int number) const -> bool;
+    auto bytes(int number) const -> qint64;
+    auto bytes(int number, Tier tier) const -> qint64;
+
+    void insertData(int number, const QByteArray &data);
+    void insertImage(int number, const QImage &image);
+    void insertScaled(int number, const QImage &image);
+    void remove(int number, Tier tier);
+    void remove(int number);
+    void clear();
+
+Q_SIGNALS:
+    void evicted(int number, PageCache::Tier tier);
+
+private:
+    struct Entry {
+        QByteArray data;
+        QImage image;
+        // kept as an image so grayscale pages stay 8 bit until they are painted
+        QImage scaled;
+        quint64 lastUsed{0};
+    };
+
+    static auto tierBytes(const Entry &entry, Tier tier) -> qint64;
+    auto distance(int number) const -> int;
+    void touch(int number);
+    void evict();
+
+    mutable QHash<int, Entry> m_entries;
+    mutable quint64 m_clock{0};
+    qint64 m_budget{0};
+    qint64 m_size{0};
+    int m_firstVisible{-1};
+    int m_lastVisible{-1};
+};
+
+#endif // PAGECACHE_H
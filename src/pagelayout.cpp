@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pagelayout.h"
+
+void PageLayout::clear()
+{
+    m_tree.clear();
+    m_sizes.clear();
+    m_widths.clear();
+    m_topBit = 0;
+}
+
+void PageLayout::setSizes(const std::vector<QSize> &sizes, int spacing)
+{
+    m_sizes = sizes;
+    m_spacing = spacing;
+    m_widths.clear();
+
+    const int n = count();
+    m_tree.assign(n + 1, 0);
+    for (int i = 1; i <= n; ++i) {
+        const QSize &size = m_sizes[i - 1];
+        m_tree[i] += space(size);
+        const int parent = i + (i & -i);
+        if (parent <= n) {
+            m_tree[parent] += m_tree[i];
+        }
+        m_widths[size.width()]++;
+    }
+
+    m_topBit = 1;
+    while (m_topBit * 2 <= n) {
+        m_topBit *= 2;
+    }
+}
+
+void PageLayout::setSize(int index, const QSize &size)
+{
+    QSize &old = m_sizes[index];
+    if (old == size) {
+        return;
+    }
+    if (old.width() != size.width()) {
+        auto it = m_widths.find(old.width());
+        if (--it.value() == 0) {
+            m_widths.erase(it);
+        }
+        m_widths[size.width()]++;
+    }
+    add(index, space(size) - space(old));
+    old = size;
+}
+
+auto PageLayout::count() const -> int
+{
+    return static_cast<int>(m_sizes.size());
+}
+
+auto PageLayout::size(int index) const -> QSize
+{
+    return m_sizes[index];
+}
+
+auto PageLayout::start(int index) const -> int
+{
+    return prefix(index);
+}
+
+auto PageLayout::end(int index) const -> int
+{
+    return prefix(index) + m_sizes[index].height();
+}
+
+auto PageLayout::pageAt(int y) const -> int
+{
+    if (m_sizes.empty() || y < 0) {
+        return 0;
+    }
+    // descend the tree to the last page that starts at or above y
+    int pos = 0;
+    int remaining = y;
+    for (int step = m_topBit; step > 0; step /= 2) {
+        const int next = pos + step;
+        if (next <= count() && m_tree[next] <= remaining) {
+            pos = next;
+            remaining -= m_tree[next];
+        }
+    }
+    // y can be below that page, in the spacing after it
+    if (pos < count() && end(pos) <= y) {
+        ++pos;
+    }
+    return pos;
+}
+
+auto PageLayout::height() const -> int
+{
+    if (m_sizes.empty()) {
+        return 0;
+    }
+    return end(count() - 1);
+}
+
+auto PageLayout::maxWidth() const -> int
+{
+    return m_widths.isEmpty() ? 0 : m_widths.lastKey();
+}
+
+auto PageLayout::space(const QSize &size) const -> int
+{
+    // pages without height (unreadable files) don't get spacing either
+    return size.height() > 0 ? size.height() + m_spacing : 0;
+}
+
+void PageLayout::add(int index, int delta)
+{
+    for (int i = index + 1; i <= count(); i += i & -i) {
+        m_tree[i] += delta;
+    }
+}
+
+auto PageLayout::prefix(int count) const -> int
+{
+    int sum = 0;
+    for (int i = count; i > 0; i -= i & -i) {
+        sum += m_tree[i];
+    }
+    return sum;
+}
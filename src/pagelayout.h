@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef PAGELAYOUT_H
+#define PAGELAYOUT_H
+
+#include <QMap>
+#include <QSize>
+
+#include <vector>
+
+// vertical positions of the pages, stored as a prefix-sum (Fenwick) tree of page heights
+// so changing the size of one page moves all pages after it in O(log n)
+class PageLayout
+{
+public:
+    void clear();
+    // replaces all page sizes, O(n)
+    void setSizes(const std::vector<QSize> &sizes, int spacing);
+    // O(log n)
+    void setSize(int index, const QSize &size);
+
+    auto count() const -> int;
+    auto size(int index) const -> QSize;
+    auto start(int index) const -> int;
+    auto end(int index) const -> int;
+    // first page whose bottom is below y, count() when there is none
+    auto pageAt(int y) const -> int;
+    auto height() const -> int;
+    auto maxWidth() const -> int;
+
+private:
+    auto space(const QSize &size) const -> int;
+    void add(int index, int delta);
+    auto prefix(int count) const -> int;
+
+    // one based, each node holds the sum of a power of two sized range of height + spacing
+    std::vector<int> m_tree;
+    std::vector<QSize> m_sizes;
+    // page width -> number of pages with that width, the last key is the widest page
+    QMap<int, int> m_widths;
+    int m_spacing{0};
+    int m_topBit{0};
+};
+
+#endif // PAGELAYOUT_H
@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pagetable.h"
+
+void PageTable::clear()
+{
+    // pending resizes belong to pages that no longer exist
+    for (const Worker::Token &token : resizeToken) {
+        if (token) {
+            token->store(true);
+        }
+    }
+    for (const Worker::Token &token : requestToken) {
+        if (token) {
+            token->store(true);
+        }
+    }
+    file.clear();
+    sourceSize.clear();
+    probed.clear();
+    available.clear();
+    scaledSize.clear();
+    zoom.clear();
+    zoomToggled.clear();
+    state.clear();
+    requestToken.clear();
+    decodeSize.clear();
+    scaledImageSize.clear();
+    resizeSize.clear();
+    resizeToken.clear();
+    reloadSize.clear();
+}
+
+void PageTable::append(int fileIndex, const QSize &size, bool isProbed)
+{
+    file.push_back(fileIndex);
+    sourceSize.push_back(size);
+    probed.push_back(isProbed);
+    available.push_back(true);
+    scaledSize.emplace_back(0, 0);
+    zoom.push_back(1.0);
+    zoomToggled.push_back(false);
+    state.push_back(State::Idle);
+    requestToken.emplace_back();
+    decodeSize.emplace_back();
+    scaledImageSize.emplace_back();
+    resizeSize.emplace_back();
+    resizeToken.emplace_back();
+    reloadSize.emplace_back();
+}
+
+auto PageTable::count() const -> int
+{
+    return static_cast<int>(file.size());
+}
+
+#include "moc_pagetable.cpp"
@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+#include <QObject>
+#include <QSize>
+
+#include <vector>
+
+#include "worker.h"
+
+// metadata of all pages as parallel arrays indexed by page number,
+// graphics items only exist for the pages near the viewport
+struct PageTable {
+    Q_GADGET
+
+public:
+    // lifecycle of a page's image
+    enum class State {
+        Idle,       // nothing requested
+        Requested,  // waiting for the worker to decode it
+        Decoded,    // source image cached, waiting for the resize
+        Scaled,     // scaled image cached, ready to paint
+        Evicted,    // scaled image dropped by the page cache
+    };
+    Q_ENUM(State)
+
+    void clear();
+    void append(int fileIndex, const QSize &size, bool isProbed);
+    auto count() const -> int;
+
+    // index into the view's file list
+    std::vector<int> file;
+    std::vector<QSize> sourceSize;
+    // false while sourceSize is an estimate
+    std::vector<bool> probed;
+    // false while the file is still being extracted
+    std::vector<bool> available;
+    // size the page is laid out with, the offsets are kept by PageLayout
+    std::vector<QSize> scaledSize;
+    std::vector<double> zoom;
+    std::vector<bool> zoomToggled;
+    std::vector<State> state;
+    std::vector<Worker::Token> requestToken;
+    // the size the cached source was decoded for, invalid when decoded at full size
+    std::vector<QSize> decodeSize;
+    // the size the cached scaled image was resized for
+    std::vector<QSize> scaledImageSize;
+    std::vector<QSize> resizeSize;
+    std::vector<Worker::Token> resizeToken;
+    // the size a new decode was requested for after the source image was dropped
+    std::vector<QSize> reloadSize;
+};
+
+#endif // PAGETABLE_H
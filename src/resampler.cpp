@@ -0,0 +1,529 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RESAMPLER_TARGET(x)
+#else
+#define RESAMPLER_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RESAMPLER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// weights are 2.14 fixed point, so they fit the 16 bit multiply-add instructions
+constexpr int PrecisionBits = 14;
+constexpr int Half = 1 << (PrecisionBits - 1);
+constexpr double Pi = 3.14159265358979323846;
+
+struct Coefficients {
+    // weights per output pixel, the same for all pixels of an axis
+    int taps{0};
+    // first source pixel of every output pixel
+    std::vector<int> offsets;
+    // taps weights for every output pixel
+    std::vector<int16_t> weights;
+};
+
+using HorizontalPass = void (*)(const uchar *src, uchar *dst, int dstWidth, const Coefficients &c);
+using VerticalPass = void (*)(const uchar *src, qsizetype stride, uchar *dst, int bytes,
+                              const int16_t *weights, int taps);
+
+struct Kernels {
+    HorizontalPass horizontal1;
+    HorizontalPass horizontal4;
+    VerticalPass vertical;
+};
+
+auto support(Resampler::Filter filter) -> double
+{
+    switch (filter) {
+    case Resampler::Filter::Box:
+        return 0.5;
+    case Resampler::Filter::Bilinear:
+        return 1.0;
+    case Resampler::Filter::Lanczos3:
+        return 3.0;
+    }
+    return 1.0;
+}
+
+auto sinc(double x) -> double
+{
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= Pi;
+    return std::sin(x) / x;
+}
+
+auto filterValue(Resampler::Filter filter, double x) -> double
+{
+    switch (filter) {
+    case Resampler::Filter::Box:
+        return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+    case Resampler::Filter::Bilinear:
+        x = std::abs(x);
+        return x < 1.0 ? 1.0 - x : 0.0;
+    case Resampler::Filter::Lanczos3:
+        return (x > -3.0 && x < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+auto computeCoefficients(int inSize, int outSize, Resampler::Filter filter) -> Coefficients
+{
+    const double scale = static_cast<double>(inSize) / outSize;
+    // when downscaling the filter is stretched so every source pixel contributes
+    const double filterScale = std::max(scale, 1.0);
+    const double filterSupport = support(filter) * filterScale;
+
+    Coefficients c;
+    c.taps = std::min(static_cast<int>(std::ceil(filterSupport)) * 2 + 1, inSize);
+    c.offsets.resize(outSize);
+    c.weights.assign(static_cast<size_t>(outSize) * c.taps, 0);
+
+    std::vector<double> weights(c.taps);
+    for (int i = 0; i < outSize; ++i) {
+        const double center = (i + 0.5) * scale;
+        const int first = std::max(static_cast<int>(std::floor(center - filterSupport + 0.5)), 0);
+        const int last = std::min(static_cast<int>(std::floor(center + filterSupport + 0.5)), inSize);
+        // the window is moved inside the image near the edges, the extra taps get a zero weight
+        const int offset = std::min(first, inSize - c.taps);
+
+        double total = 0.0;
+        for (int k = 0; k < c.taps; ++k) {
+            const int x = offset + k;
+            weights[k] = (x >= first && x < last) ? filterValue(filter, (x + 0.5 - center) / filterScale) : 0.0;
+            total += weights[k];
+        }
+        if (total == 0.0) {
+            const int nearest = std::clamp(static_cast<int>(center), offset, offset + c.taps - 1);
+            weights[nearest - offset] = 1.0;
+            total = 1.0;
+        }
+
+        // quantize, the rounding error goes to the largest weight so the weights sum to exactly 1.0
+        int16_t *w = &c.weights[static_cast<size_t>(i) * c.taps];
+        int sum = 0;
+        int largest = 0;
+        for (int k = 0; k < c.taps; ++k) {
+            w[k] = static_cast<int16_t>(std::lround(weights[k] / total * (1 << PrecisionBits)));
+            sum += w[k];
+            if (w[k] > w[largest]) {
+                largest = k;
+            }
+        }
+        w[largest] = static_cast<int16_t>(w[largest] + (1 << PrecisionBits) - sum);
+        c.offsets[i] = offset;
+    }
+    return c;
+}
+
+inline auto clampToByte(int value) -> uchar
+{
+    return static_cast<uchar>(std::clamp(value >> PrecisionBits, 0, 255));
+}
+
+// two weights packed for the 16 bit multiply-add instructions
+inline auto weightPair(int16_t first, int16_t second) -> int
+{
+    return static_cast<int>(static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16
+                            | static_cast<uint16_t>(first));
+}
+
+template<int Channels>
+void horizontalScalar(const uchar *src, uchar *dst, int dstWidth, const Coefficients &c)
+{
+    for (int x = 0; x < dstWidth; ++x) {
+        const uchar *s = src + c.offsets[x] * Channels;
+        const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+        int acc[Channels];
+        std::fill(acc, acc + Channels, Half);
+        for (int k = 0; k < c.taps; ++k) {
+            for (int ch = 0; ch < Channels; ++ch) {
+                acc[ch] += s[k * Channels + ch] * w[k];
+            }
+        }
+        for (int ch = 0; ch < Channels; ++ch) {
+            dst[x * Channels + ch] = clampToByte(acc[ch]);
+        }
+    }
+}
+
+void verticalScalar(const uchar *src, qsizetype stride, uchar *dst, int bytes, const int16_t *weights, int taps)
+{
+    for (int i = 0; i < bytes; ++i) {
+        int acc = Half;
+        for (int k = 0; k < taps; ++k) {
+            acc += src[k * stride + i] * weights[k];
+        }
+        dst[i] = clampToByte(acc);
+    }
+}
+
+#ifdef RESAMPLER_X86
+
+RESAMPLER_TARGET("sse4.1")
+void horizontal4Sse41(const uchar *src, uchar *dst, int dstWidth, const Coefficients &c)
+{
+    // interleaves the channels of two pixels as 16 bit values: p0c0 p1c0 p0c1 p1c1 ...
+    const __m128i shuffle = _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+    for (int x = 0; x < dstWidth; ++x) {
+        const uchar *s = src + c.offsets[x] * 4;
+        const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+        __m128i acc = _mm_set1_epi32(Half);
+        int k = 0;
+        for (; k + 1 < c.taps; k += 2) {
+            __m128i pixels = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + k * 4));
+            pixels = _mm_shuffle_epi8(pixels, shuffle);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pixels, _mm_set1_epi32(weightPair(w[k], w[k + 1]))));
+        }
+        if (k < c.taps) {
+            int32_t pixel;
+            std::memcpy(&pixel, s + k * 4, 4);
+            const __m128i pixels = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixel));
+            acc = _mm_add_epi32(acc, _mm_mullo_epi32(pixels, _mm_set1_epi32(w[k])));
+        }
+        acc = _mm_srai_epi32(acc, PrecisionBits);
+        acc = _mm_packs_epi32(acc, acc);
+        acc = _mm_packus_epi16(acc, acc);
+        const int32_t result = _mm_cvtsi128_si32(acc);
+        std::memcpy(dst + x * 4, &result, 4);
+    }
+}
+
+RESAMPLER_TARGET("sse4.1")
+void horizontal1Sse41(const uchar *src, uchar *dst, int dstWidth, const Coefficients &c)
+{
+    for (int x = 0; x < dstWidth; ++x) {
+        const uchar *s = src + c.offsets[x];
+        const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+        __m128i acc = _mm_setzero_si128();
+        int k = 0;
+        for (; k + 7 < c.taps; k += 8) {
+            const __m128i pixels = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + k)));
+            const __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i *>(w + k));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pixels, weights));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        int sum = _mm_cvtsi128_si32(acc) + Half;
+        for (; k < c.taps; ++k) {
+            sum += s[k] * w[k];
+        }
+        dst[x] = clampToByte(sum);
+    }
+}
+
+RESAMPLER_TARGET("sse4.1")
+void verticalSse41(const uchar *src, qsizetype stride, uchar *dst, int bytes, const int16_t *weights, int taps)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 7 < bytes; i += 8) {
+        __m128i low = _mm_set1_epi32(Half);
+        __m128i high = low;
+        int k = 0;
+        for (; k < taps; k += 2) {
+            const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + k * stride + i)));
+            const __m128i b = k + 1 < taps
+                ? _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + (k + 1) * stride + i)))
+                : zero;
+            const __m128i w = _mm_set1_epi32(weightPair(weights[k], k + 1 < taps ? weights[k + 1] : 0));
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        low = _mm_srai_epi32(low, PrecisionBits);
+        high = _mm_srai_epi32(high, PrecisionBits);
+        __m128i result = _mm_packs_epi32(low, high);
+        result = _mm_packus_epi16(result, result);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), result);
+    }
+    verticalScalar(src + i, stride, dst + i, bytes - i, weights, taps);
+}
+
+RESAMPLER_TARGET("avx2")
+void verticalAvx2(const uchar *src, qsizetype stride, uchar *dst, int bytes, const int16_t *weights, int taps)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 15 < bytes; i += 16) {
+        // low holds bytes 0-3 and 8-11, high holds bytes 4-7 and 12-15
+        __m256i low = _mm256_set1_epi32(Half);
+        __m256i high = low;
+        for (int k = 0; k < taps; k += 2) {
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k * stride + i)));
+            const __m256i b = k + 1 < taps
+                ? _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (k + 1) * stride + i)))
+                : zero;
+            const __m256i w = _mm256_set1_epi32(weightPair(weights[k], k + 1 < taps ? weights[k + 1] : 0));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        low = _mm256_srai_epi32(low, PrecisionBits);
+        high = _mm256_srai_epi32(high, PrecisionBits);
+        __m256i result = _mm256_packs_epi32(low, high);
+        result = _mm256_packus_epi16(result, result);
+        result = _mm256_permute4x64_epi64(result, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(result));
+    }
+    verticalSse41(src + i, stride, dst + i, bytes - i, weights, taps);
+}
+
+void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuidex(reinterpret_cast<int *>(regs), leaf, subleaf);
+#else
+    __asm__("cpuid" : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3]) : "a"(leaf), "c"(subleaf));
+#endif
+}
+
+auto cpuSupports(int leaf, int subleaf, int reg, int bit) -> bool
+{
+    // leaves above the highest one the cpu reports return garbage
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    if (static_cast<unsigned int>(leaf) > regs[0]) {
+        return false;
+    }
+    cpuid(leaf, subleaf, regs);
+    return regs[reg] & (1u << bit);
+}
+
+auto hasSse41() -> bool
+{
+    return cpuSupports(1, 0, 2, 19);
+}
+
+auto hasAvx2() -> bool
+{
+    // the OS also has to save the ymm registers
+    if (!cpuSupports(1, 0, 2, 27) || !cpuSupports(1, 0, 2, 28)) {
+        return false;
+    }
+#if defined(_MSC_VER) && !defined(__clang__)
+    const unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int eax;
+    unsigned int edx;
+    __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    const unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+    return (xcr0 & 0x6) == 0x6 && cpuSupports(7, 0, 1, 5);
+}
+
+#endif // RESAMPLER_X86
+
+#ifdef RESAMPLER_NEON
+
+void horizontal4Neon(const uchar *src, uchar *dst, int dstWidth, const Coefficients &c)
+{
+    for (int x = 0; x < dstWidth; ++x) {
+        const uchar *s = src + c.offsets[x] * 4;
+        const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+        int32x4_t acc = vdupq_n_s32(Half);
+        int k = 0;
+        for (; k + 1 < c.taps; k += 2) {
+            const int16x8_t pixels = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(s + k * 4)));
+            acc = vmlal_n_s16(acc, vget_low_s16(pixels), w[k]);
+            acc = vmlal_n_s16(acc, vget_high_s16(pixels), w[k + 1]);
+        }
+        if (k < c.taps) {
+            uint32_t pixel;
+            std::memcpy(&pixel, s + k * 4, 4);
+            const uint16x8_t pixels = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)));
+            acc = vmlal_n_s16(acc, vreinterpret_s16_u16(vget_low_u16(pixels)), w[k]);
+        }
+        const int16x4_t narrow = vqshrn_n_s32(acc, PrecisionBits);
+        const uint8x8_t result = vqmovun_s16(vcombine_s16(narrow, narrow));
+        vst1_lane_u32(reinterpret_cast<uint32_t *>(dst + x * 4), vreinterpret_u32_u8(result), 0);
+    }
+}
+
+void horizontal1Neon(const uchar *src, uchar *dst, int dstWidth, const Coefficients &c)
+{
+    for (int x = 0; x < dstWidth; ++x) {
+        const uchar *s = src + c.offsets[x];
+        const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+        int32x4_t acc = vdupq_n_s32(0);
+        int k = 0;
+        for (; k + 7 < c.taps; k += 8) {
+            const int16x8_t pixels = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(s + k)));
+            const int16x8_t weights = vld1q_s16(w + k);
+            acc = vmlal_s16(acc, vget_low_s16(pixels), vget_low_s16(weights));
+            acc = vmlal_s16(acc, vget_high_s16(pixels), vget_high_s16(weights));
+        }
+        int sum = vaddvq_s32(acc) + Half;
+        for (; k < c.taps; ++k) {
+            sum += s[k] * w[k];
+        }
+        dst[x] = clampToByte(sum);
+    }
+}
+
+void verticalNeon(const uchar *src, qsizetype stride, uchar *dst, int bytes, const int16_t *weights, int taps)
+{
+    int i = 0;
+    for (; i + 7 < bytes; i += 8) {
+        int32x4_t low = vdupq_n_s32(Half);
+        int32x4_t high = low;
+        for (int k = 0; k < taps; ++k) {
+            const int16x8_t pixels = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src + k * stride + i)));
+            low = vmlal_n_s16(low, vget_low_s16(pixels), weights[k]);
+            high = vmlal_n_s16(high, vget_high_s16(pixels), weights[k]);
+        }
+        const int16x8_t narrow = vcombine_s16(vqshrn_n_s32(low, PrecisionBits), vqshrn_n_s32(high, PrecisionBits));
+        vst1_u8(dst + i, vqmovun_s16(narrow));
+    }
+    verticalScalar(src + i, stride, dst + i, bytes - i, weights, taps);
+}
+
+#endif // RESAMPLER_NEON
+
+auto kernels() -> const Kernels &
+{
+    static const Kernels selected = []() -> Kernels {
+#ifdef RESAMPLER_X86
+        if (hasAvx2()) {
+            // the horizontal passes work on a few pixels at a time, wider registers don't pay off there
+            return {horizontal1Sse41, horizontal4Sse41, verticalAvx2};
+        }
+        if (hasSse41()) {
+            return {horizontal1Sse41, horizontal4Sse41, verticalSse41};
+        }
+#endif
+#ifdef RESAMPLER_NEON
+        return {horizontal1Neon, horizontal4Neon, verticalNeon};
+#endif
+        return {horizontalScalar<1>, horizontalScalar<4>, verticalScalar};
+    }();
+    return selected;
+}
+
+// average of fx * fy blocks, used for box filtering by whole factors
+void boxDownscale(const uchar *src, qsizetype srcStride, uchar *dst, int dstWidth, int dstHeight,
+                  qsizetype dstStride, int channels, int fx, int fy)
+{
+    const int bytes = dstWidth * channels;
+    const uint32_t area = static_cast<uint32_t>(fx * fy);
+    std::vector<uint32_t> sums(bytes);
+    for (int y = 0; y < dstHeight; ++y) {
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int r = 0; r < fy; ++r) {
+            const uchar *row = src + (static_cast<qsizetype>(y) * fy + r) * srcStride;
+            for (int x = 0; x < dstWidth; ++x) {
+                const uchar *block = row + x * fx * channels;
+                uint32_t *sum = &sums[x * channels];
+                for (int i = 0; i < fx; ++i) {
+                    for (int ch = 0; ch < channels; ++ch) {
+                        sum[ch] += block[i * channels + ch];
+                    }
+                }
+            }
+        }
+        uchar *out = dst + y * dstStride;
+        for (int i = 0; i < bytes; ++i) {
+            out[i] = static_cast<uchar>((sums[i] + area / 2) / area);
+        }
+    }
+}
+
+} // namespace
+
+void Resampler::resample(const uchar *src, int srcWidth, int srcHeight, qsizetype srcStride,
+                         uchar *dst, int dstWidth, int dstHeight, qsizetype dstStride,
+                         int channels, Filter filter)
+{
+    if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+        return;
+    }
+
+    if (filter == Filter::Box && srcWidth % dstWidth == 0 && srcHeight % dstHeight == 0) {
+        boxDownscale(src, srcStride, dst, dstWidth, dstHeight, dstStride,
+                     channels, srcWidth / dstWidth, srcHeight / dstHeight);
+        return;
+    }
+
+    const Kernels &k = kernels();
+    const HorizontalPass horizontal = channels == 1 ? k.horizontal1 : k.horizontal4;
+    const int bytes = dstWidth * channels;
+    const Coefficients columns = computeCoefficients(srcWidth, dstWidth, filter);
+    const Coefficients rows = computeCoefficients(srcHeight, dstHeight, filter);
+
+    // horizontal pass over the source rows the vertical pass needs
+    const int firstRow = rows.offsets.front();
+    const int lastRow = rows.offsets.back() + rows.taps;
+    std::vector<uchar> buffer(static_cast<size_t>(lastRow - firstRow) * bytes);
+    for (int y = firstRow; y < lastRow; ++y) {
+        horizontal(src + y * srcStride, &buffer[static_cast<size_t>(y - firstRow) * bytes], dstWidth, columns);
+    }
+
+    for (int y = 0; y < dstHeight; ++y) {
+        k.vertical(&buffer[static_cast<size_t>(rows.offsets[y] - firstRow) * bytes], bytes,
+                   dst + y * dstStride, bytes,
+                   &rows.weights[static_cast<size_t>(y) * rows.taps], rows.taps);
+    }
+}
+
+auto Resampler::scaled(const QImage &image, const QSize &size, Filter filter) -> QImage
+{
+    if (image.isNull() || size.isEmpty()) {
+        return {};
+    }
+    if (image.size() == size) {
+        return image;
+    }
+
+    QImage source = image;
+    if (image.format() != QImage::Format_Grayscale8 && image.format() != QImage::Format_RGB32) {
+        // filtering premultiplied pixels keeps transparent colors from bleeding into their neighbours
+        source = image.convertToFormat(image.hasAlphaChannel()
+                                       ? QImage::Format_ARGB32_Premultiplied
+                                       : QImage::Format_RGB32);
+    }
+    const int channels = source.format() == QImage::Format_Grayscale8 ? 1 : 4;
+
+    QImage result(size, source.format());
+    if (result.isNull()) {
+        return {};
+    }
+    resample(source.constBits(), source.width(), source.height(), source.bytesPerLine(),
+             result.bits(), result.width(), result.height(), result.bytesPerLine(),
+             channels, filter);
+
+    // lanczos overshoot can leave colors brighter than their alpha
+    if (result.format() == QImage::Format_ARGB32_Premultiplied && filter == Filter::Lanczos3) {
+        for (int y = 0; y < result.height(); ++y) {
+            auto line = reinterpret_cast<QRgb *>(result.scanLine(y));
+            for (int x = 0; x < result.width(); ++x) {
+                const int alpha = qAlpha(line[x]);
+                line[x] = qRgba(std::min(qRed(line[x]), alpha),
+                                std::min(qGreen(line[x]), alpha),
+                                std::min(qBlue(line[x]), alpha),
+                                alpha);
+            }
+        }
+    }
+    result.setColorSpace(source.colorSpace());
+    return result;
+}
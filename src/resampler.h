@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QImage>
+
+namespace Resampler
+{
+
+// same order as the FilterQuality choices in settings.kcfg
+enum class Filter {
+    Box,
+    Bilinear,
+    Lanczos3
+};
+
+// scales image to exactly size, grayscale images stay in Format_Grayscale8
+auto scaled(const QImage &image, const QSize &size, Filter filter) -> QImage;
+
+// resamples raw pixel rows, channels is 1 (grayscale) or 4 (32 bit formats)
+void resample(const uchar *src, int srcWidth, int srcHeight, qsizetype srcStride,
+              uchar *dst, int dstWidth, int dstHeight, qsizetype dstStride,
+              int channels, Filter filter);
+
+} // namespace Resampler
+
+#endif // RESAMPLER_H
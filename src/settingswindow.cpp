@@ -7,6 +7,7 @@
 #include "settingswindow.h"
 
 #include <QCheckBox>
+#include <QComboBox>
 #include <QFileDialog>
 #include <QFormLayout>
 #include <QLabel>
@@ -70,6 +71,20 @@ SettingsWindow::SettingsWindow(QWidget *parent, KConfigSkeleton *skeleton)
     // end unrar
 
 
+    // extraction cache size
+    m_extractionCacheSize = new QSpinBox(this);
+    m_extractionCacheSize->setObjectName(QStringLiteral("kcfg_ExtractionCacheSize"));
+    m_extractionCacheSize->setMinimum(0);
+    m_extractionCacheSize->setMaximum(1048576);
+    m_extractionCacheSize->setSuffix(i18n(" MiB"));
+    m_extractionCacheSize->setValue(MangaReaderSettings::extractionCacheSize());
+    m_extractionCacheSize->setToolTip(i18n("Disk space used to keep extracted .rar and .cbr files.\n"
+                                           "Archives in the cache open again without extracting them,\n"
+                                           "the least recently opened ones are deleted first."));
+    formLayout->addRow(i18n("Extraction cache size"), m_extractionCacheSize);
+    // end extraction cache size
+
+
     // start in fullscreen mode
     m_fullscreenStartup = new QCheckBox(this);
     m_fullscreenStartup->setObjectName(QStringLiteral("kcfg_FullscreenOnStartup"));
@@ -122,6 +137,86 @@ SettingsWindow::SettingsWindow(QWidget *parent, KConfigSkeleton *skeleton)
     // end page spacing
 
 
+    // page cache size
+    m_cacheSize = new QSpinBox(this);
+    m_cacheSize->setObjectName(QStringLiteral("kcfg_CacheSize"));
+    m_cacheSize->setMinimum(64);
+    m_cacheSize->setMaximum(65536);
+    m_cacheSize->setSuffix(i18n(" MiB"));
+    m_cacheSize->setValue(MangaReaderSettings::cacheSize());
+    m_cacheSize->setToolTip(i18n("Memory used to keep pages that scrolled out of view.\n"
+                                 "Pages in the cache are shown again without reloading them."));
+    formLayout->addRow(i18n("Page cache size"), m_cacheSize);
+    // end page cache size
+
+
+    // source images
+    m_sourceImages = new QComboBox(this);
+    m_sourceImages->setObjectName(QStringLiteral("kcfg_SourceImages"));
+    m_sourceImages->addItem(i18n("Keep in the page cache"));
+    m_sourceImages->addItem(i18n("Drop after resizing"));
+    m_sourceImages->setCurrentIndex(MangaReaderSettings::sourceImages());
+    m_sourceImages->setToolTip(i18n("Keeping the decoded images makes zooming and resizing faster.\n"
+                                    "Dropping them roughly halves the memory used by loaded pages,\n"
+                                    "they are decoded again when the page size changes."));
+    formLayout->addRow(i18n("Decoded images"), m_sourceImages);
+    // end source images
+
+
+    // memory usage
+    m_showMemoryUsage = new QCheckBox(this);
+    m_showMemoryUsage->setObjectName(QStringLiteral("kcfg_ShowMemoryUsage"));
+    m_showMemoryUsage->setText(i18n("Show page memory usage in tooltips"));
+    m_showMemoryUsage->setChecked(MangaReaderSettings::showMemoryUsage());
+    formLayout->addRow(QLatin1String(), m_showMemoryUsage);
+    // end memory usage
+
+
+    // filter quality
+    m_filterQuality = new QComboBox(this);
+    m_filterQuality->setObjectName(QStringLiteral("kcfg_FilterQuality"));
+    m_filterQuality->addItem(i18n("Fast (box)"));
+    m_filterQuality->addItem(i18n("Smooth (bilinear)"));
+    m_filterQuality->addItem(i18n("Sharp (Lanczos)"));
+    m_filterQuality->setCurrentIndex(MangaReaderSettings::filterQuality());
+    m_filterQuality->setToolTip(i18n("Filter used when resizing pages, sharper filters are slower."));
+    formLayout->addRow(i18n("Resize quality"), m_filterQuality);
+    // end filter quality
+
+
+    // renderer
+    m_renderer = new QComboBox(this);
+    m_renderer->setObjectName(QStringLiteral("kcfg_Renderer"));
+    m_renderer->addItem(i18n("Graphics scene"));
+    m_renderer->addItem(i18n("Direct strip"));
+    m_renderer->setCurrentIndex(MangaReaderSettings::renderer());
+    m_renderer->setToolTip(i18n("The direct strip renderer draws the pages without a graphics scene.\n"
+                                "Frame times of both are shown in the page memory usage tooltips."));
+    formLayout->addRow(i18n("Renderer"), m_renderer);
+    // end renderer
+
+
+    // grayscale detection
+    m_detectGrayscale = new QCheckBox(this);
+    m_detectGrayscale->setObjectName(QStringLiteral("kcfg_DetectGrayscale"));
+    m_detectGrayscale->setText(i18n("Store grayscale pages with 8 bits per pixel"));
+    m_detectGrayscale->setChecked(MangaReaderSettings::detectGrayscale());
+    m_detectGrayscale->setToolTip(i18n("Pages without color use a quarter of the memory and are resized faster."));
+    formLayout->addRow(QLatin1String(), m_detectGrayscale);
+    // end grayscale detection
+
+
+    // decoding threads
+    m_decodeThreads = new QSpinBox(this);
+    m_decodeThreads->setObjectName(QStringLiteral("kcfg_DecodeThreads"));
+    m_decodeThreads->setMinimum(1);
+    m_decodeThreads->setMaximum(64);
+    m_decodeThreads->setValue(MangaReaderSettings::decodeThreads());
+    m_decodeThreads->setToolTip(i18n("Number of threads used to load images.\nDefaults to the number of processor cores."));
+    formLayout->addRow(i18n("Decoding threads"), m_decodeThreads);
+    // end decoding threads
+
+
     // custom colors
     auto useCustomBackgroundColor = new QCheckBox(this);
     useCustomBackgroundColor->setObjectName(QStringLiteral("kcfg_UseCustomBackgroundColor"));
@@ -11,6 +11,7 @@
 #include <KConfigSkeleton>
 
 class QCheckBox;
+class QComboBox;
 class KColorButton;
 class KEditListWidget;
 class QLineEdit;
@@ -30,10 +31,18 @@ private:
     QPushButton *m_addMangaFolderButton{nullptr};
     QHash<QString, bool> changedSettings;
     KUrlRequester *m_unrarPath{nullptr};
+    QSpinBox *m_extractionCacheSize{nullptr};
     QCheckBox *m_fullscreenStartup{nullptr};
     QCheckBox *m_upscaleImages{nullptr};
     QSpinBox *m_maxWidth{nullptr};
     QSpinBox *m_pageSpacing{nullptr};
+    QSpinBox *m_decodeThreads{nullptr};
+    QSpinBox *m_cacheSize{nullptr};
+    QComboBox *m_sourceImages{nullptr};
+    QCheckBox *m_showMemoryUsage{nullptr};
+    QComboBox *m_filterQuality{nullptr};
+    QComboBox *m_renderer{nullptr};
+    QCheckBox *m_detectGrayscale{nullptr};
     KColorButton *m_backgroundColor{nullptr};
     KColorButton *m_borderColor{nullptr};
     KEditListWidget *m_mangaFolders{nullptr};
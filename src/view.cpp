@@ -14,21 +14,59 @@
 #include <QFileInfo>
 #include <QImageReader>
 #include <QMenu>
+#include <QMetaEnum>
 #include <QMimeData>
 #include <QMouseEvent>
+#include <QPainter>
 #include <QScrollBar>
+#include <QThread>
 #include <QTimer>
+#include <QToolTip>
 
 #include <KActionCollection>
 #include <KArchive>
+#include <KFormat>
 #include <KLocalizedString>
 #include <KXMLGUIFactory>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "extractor.h"
 #include "mainwindow.h"
+#include "metadatacache.h"
 #include "page.h"
+#include "pagecache.h"
 #include "settings.h"
 #include "worker.h"
 
+// smallest number of files worth probing on a separate thread
+static constexpr int MinProbeBatch = 16;
+// pages probed before anything is shown, at the start and at the start page
+static constexpr int InitialPages = 8;
+// pages probed in the background per update of the layout
+static constexpr int ProbeChunk = 64;
+
+// a decoded image whose aspect ratio doesn't match the size it was laid out with, more than rounding
+static auto differentShape(const QSize &decoded, const QSize &laidOut) -> bool
+{
+    if (decoded.isEmpty()) {
+        return false;
+    }
+    if (laidOut.isEmpty()) {
+        return true;
+    }
+    const qint64 a = static_cast<qint64>(decoded.width()) * laidOut.height();
+    const qint64 b = static_cast<qint64>(laidOut.width()) * decoded.height();
+    return std::abs(a - b) > std::max(a, b) / 100;
+}
+
+View::~View()
+{
+    stopProbing();
+}
+
 View::View(MainWindow *parent)
     : QGraphicsView{ parent }
 {
@@ -39,8 +77,8 @@ View::View(MainWindow *parent)
     m_resizeTimer->setInterval(100);
     m_resizeTimer->setSingleShot(true);
     connect(m_resizeTimer, &QTimer::timeout, this, [=]() {
-        for (Page *p : std::as_const(m_pages)) {
-            p->redrawImage();
+        for (int i = 0; i < m_table.count(); i++) {
+            redrawPage(i);
         }
         calculatePageSizes();
     });
@@ -63,12 +101,18 @@ View::View(MainWindow *parent)
 
     m_scene = new QGraphicsScene(this);
     setScene(m_scene);
-
-    connect(this, &View::requestDriveImage,
-            Worker::instance(), &Worker::processDriveImageRequest);
-
-    connect(this, &View::requestMemoryImage,
-            Worker::instance(), &Worker::processMemoryImageRequest);
+    m_stripRenderer = MangaReaderSettings::renderer() == MangaReaderSettings::EnumRenderer::Strip;
+
+    m_cache = new PageCache(this);
+    m_cache->setBudget(static_cast<qint64>(MangaReaderSettings::cacheSize()) * 1024 * 1024);
+    connect(m_cache, &PageCache::evicted, this, [=](int number, PageCache::Tier tier) {
+        // allow the page to be requested again once it is needed
+        if (tier == PageCache::Scaled) {
+            delRequest(number);
+            m_table.state[number] = PageTable::State::Evicted;
+            updatePage(number);
+        }
+    });
 
     connect(Worker::instance(), &Worker::imageReady,
             this, &View::onImageReady);
@@ -78,11 +122,11 @@ View::View(MainWindow *parent)
 
     connect(verticalScrollBar(), &QScrollBar::rangeChanged,
             this, &View::onScrollBarRangeChanged);
-    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [=]() {
-        QPoint topCenter = QPoint(m_scene->width()/2, 1);
-        Page *p = qgraphicsitem_cast<Page *>(itemAt(topCenter));
-        if (p) {
-            Q_EMIT currentImageChanged(p->number());
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [=](int value) {
+        // page under the top edge of the viewport
+        const int number = m_layout.pageAt(value + 1);
+        if (number < m_table.count() && m_layout.start(number) <= value + 1) {
+            Q_EMIT currentImageChanged(number);
         }
     });
 }
@@ -148,7 +192,7 @@ void View::setupActions()
     auto nextPage = new QAction(i18n("Next Page"));
     nextPage->setShortcutContext(Qt::WidgetShortcut);
     connect(nextPage, &QAction::triggered, this, [=]() {
-        if (m_firstVisible < m_pages.count() - 1) {
+        if (m_firstVisible < m_table.count() - 1) {
             goToPage(m_firstVisible + 1);
         }
     });
@@ -168,14 +212,26 @@ void View::setupActions()
 
 void View::reset()
 {
+    stopProbing();
     delete m_archive;
     m_archive = nullptr;
-    qDeleteAll(m_pages);
-    m_pages.clear();
-    m_start.clear();
-    m_end.clear();
-    m_requestedPages.clear();
+    clearRequests();
+    // the items are kept for the next manga
+    for (Page *item : std::as_const(m_items)) {
+        releaseItem(item);
+    }
+    m_items.clear();
+    m_table.clear();
+    m_cache->clear();
+    m_layout.clear();
+    m_windowFirst = -1;
+    m_windowLast = -1;
+    ++m_generation;
     m_files.clear();
+    m_pageSizes.clear();
+    m_extracting = false;
+    m_recursive = false;
+    m_fileNumbers.clear();
     verticalScrollBar()->setValue(0);
 }
 
@@ -185,20 +241,336 @@ void View::loadImages()
     Q_EMIT imagesLoaded(m_startPage);
     calculatePageSizes();
     setPagesVisibility();
+    startProbing();
 }
 
 void View::createPages()
 {
+    const int count = static_cast<int>(m_files.count());
+    const QString archiveFile = m_loadFromMemory ? m_manga : QString();
+    const int threadCount = MangaReaderSettings::decodeThreads();
+
+    // pages take space once their file is extracted
+    if (m_extracting) {
+        for (int i = 0; i < count; i++) {
+            m_table.append(i, QSize(0, 0), false);
+            m_table.available[i] = false;
+            m_fileNumbers.insert(m_files.at(i), i);
+        }
+        return;
+    }
+
+    // opened before, nothing has to be probed
+    MangaMetadata metadata;
+    m_metadataSaved = MetadataCache::load(m_manga, &metadata, m_recursive) && metadata.files == m_files
+            && metadata.sizes.size() == static_cast<size_t>(count);
+    if (m_metadataSaved) {
+        for (int i = 0; i < count; i++) {
+            m_table.append(i, metadata.sizes[i], true);
+        }
+        return;
+    }
+
+    // only the first pages and the ones at the start page are probed before showing anything
+    std::vector<ProbedImage> images(count);
+    std::vector<bool> probed(count, false);
+    std::vector<std::unique_ptr<KArchive>> archives;
+    auto probe = [&](int first, int last) {
+        const std::vector<ProbedImage> result = probeImages(m_files, archiveFile, first, last, threadCount, {}, &archives);
+        std::copy(result.cbegin(), result.cend(), images.begin() + first);
+        std::fill(probed.begin() + first, probed.begin() + last, true);
+    };
+    probe(0, std::min(count, InitialPages));
+    if (m_startPage > InitialPages && m_startPage < count) {
+        probe(m_startPage, std::min(count, m_startPage + InitialPages));
+    }
+
+    // sizes from the metadata are used for the pages that weren't probed,
+    // unless they disagree with the ones that were
+    std::vector<QSize> metadataSizes = m_pageSizes;
+    if (metadataSizes.size() != static_cast<size_t>(count)) {
+        metadataSizes.clear();
+    }
+    for (int i = 0; i < static_cast<int>(metadataSizes.size()); i++) {
+        if (probed[i] && metadataSizes[i].isValid() && metadataSizes[i] != images[i].size) {
+            metadataSizes.clear();
+        }
+    }
+
+    // the others start with the average size of the probed pages
+    QSize estimate;
+    qint64 width = 0;
+    qint64 height = 0;
+    int known = 0;
+    for (int i = 0; i < count; i++) {
+        const QSize &size = images[i].size;
+        if (probed[i] && size.isValid()) {
+            width += size.width();
+            height += size.height();
+            ++known;
+        }
+    }
+    if (known > 0) {
+        estimate = QSize(static_cast<int>(width / known), static_cast<int>(height / known));
+    }
+
+    // every file gets a page so numbers don't change when the sizes arrive,
+    // files that can't be read end up with an empty page that takes no space
+    for (int i = 0; i < count; i++) {
+        if (probed[i]) {
+            const QSize &size = images[i].size;
+            m_table.append(i, size.isValid() ? size : QSize(0, 0), true);
+        } else if (!metadataSizes.empty() && metadataSizes[i].isValid()) {
+            m_table.append(i, metadataSizes[i], true);
+        } else {
+            m_table.append(i, estimate.isValid() ? estimate : QSize(0, 0), false);
+        }
+    }
+}
+
+void View::startProbing()
+{
+    // files are probed as they are extracted
+    if (m_extracting) {
+        return;
+    }
+
+    const QStringList files = m_files;
+    const QString archiveFile = m_loadFromMemory ? m_manga : QString();
+    const int threadCount = MangaReaderSettings::decodeThreads();
+    const int generation = m_generation;
+    const std::vector<bool> probed = m_table.probed;
+    if (std::find(probed.cbegin(), probed.cend(), false) == probed.cend()) {
+        saveMetadata();
+        return;
+    }
+
+    Worker::Token token = std::make_shared<std::atomic_bool>(false);
+    m_probeToken = token;
+    m_probeThread = QThread::create([=]() {
+        // runs of pages that weren't probed yet, in order and in small chunks
+        // so results show up quickly and cancelling doesn't wait long;
+        // the archive is opened once per thread for all of them
+        std::vector<std::unique_ptr<KArchive>> archives;
+        const int count = static_cast<int>(files.count());
+        int first = 0;
+        while (first < count && !token->load()) {
+            if (probed[first]) {
+                ++first;
+                continue;
+            }
+            int last = first;
+            while (last < count && last - first < ProbeChunk && !probed[last]) {
+                ++last;
+            }
+            std::vector<ProbedImage> images = probeImages(files, archiveFile, first, last, threadCount, token, &archives);
+            if (token->load()) {
+                break;
+            }
+            QMetaObject::invokeMethod(this, [=, images = std::move(images)]() {
+                if (generation == m_generation) {
+                    onPagesProbed(first, images);
+                }
+            }, Qt::QueuedConnection);
+            first = last;
+        }
+    });
+    m_probeThread->setObjectName(QStringLiteral("prober"));
+    m_probeThread->start();
+}
+
+void View::stopProbing()
+{
+    if (m_probeToken) {
+        m_probeToken->store(true);
+        m_probeToken.reset();
+    }
+    if (m_probeThread) {
+        m_probeThread->wait();
+        delete m_probeThread;
+        m_probeThread = nullptr;
+    }
+}
+
+void View::onPagesProbed(int first, const std::vector<ProbedImage> &images)
+{
+    for (int i = 0; i < static_cast<int>(images.size()); i++) {
+        const int number = first + i;
+        // already sized from its decoded image
+        if (m_table.probed[number]) {
+            continue;
+        }
+        m_table.probed[number] = true;
+        const QSize &size = images[i].size;
+        setSourceSize(number, size.isValid() ? size : QSize(0, 0));
+    }
+    relayout();
+
+    if (std::find(m_table.probed.cbegin(), m_table.probed.cend(), false) == m_table.probed.cend()) {
+        saveMetadata();
+    }
+}
+
+void View::saveMetadata()
+{
+    if (m_metadataSaved) {
+        return;
+    }
+    m_metadataSaved = true;
+
+    MangaMetadata metadata;
+    metadata.files = m_files;
+    metadata.sizes = m_table.sourceSize;
+    if (m_loadFromMemory && m_archive && m_archive->directory()) {
+        metadata.offsets.reserve(m_files.count());
+        for (const QString &file : std::as_const(m_files)) {
+            const KArchiveFile *entry = m_archive->directory()->file(file);
+            metadata.offsets.push_back(entry ? entry->position() : -1);
+        }
+    }
+    MetadataCache::save(m_manga, metadata, m_recursive);
+}
+
+void View::setRecursive(bool recursive)
+{
+    m_recursive = recursive;
+}
+
+void View::setExtracting(bool extracting)
+{
+    m_extracting = extracting;
+}
+
+auto View::isExtracting() const -> bool
+{
+    return m_extracting;
+}
+
+void View::fileExtracted(const QString &file)
+{
+    const int number = m_fileNumbers.value(file, -1);
+    if (number < 0 || m_table.available[number]) {
+        return;
+    }
+    setFileAvailable(number);
+    relayout();
+}
+
+void View::extractionFinished()
+{
+    if (!m_extracting) {
+        return;
+    }
+    m_extracting = false;
+    m_fileNumbers.clear();
+    // files whose line in unrar's output wasn't recognized, or that failed to extract,
+    // can be many; they are probed on the probe thread like the pages of a folder
+    for (int i = 0; i < m_table.count(); i++) {
+        m_table.available[i] = true;
+    }
+    setPagesVisibility();
+    startProbing();
+}
+
+void View::setFileAvailable(int number)
+{
+    // a single header read, cheap enough for the GUI thread
+    const std::vector<ProbedImage> images = probeImages(m_files, QString(), number, number + 1, 1);
+    m_table.available[number] = true;
+    m_table.probed[number] = true;
+    setSourceSize(number, images[0].size.isValid() ? images[0].size : QSize(0, 0));
+}
+
+void View::setSourceSize(int number, const QSize &size)
+{
+    if (m_table.sourceSize[number] == size) {
+        return;
+    }
+    m_table.sourceSize[number] = size;
+    m_table.scaledSize[number] = calculateScaledSize(number);
+    m_layout.setSize(number, m_table.scaledSize[number]);
+}
+
+void View::relayout()
+{
+    // keep the page at the top of the viewport where it was while the pages above it change size
+    const int anchor = m_firstVisible;
+    const float anchorOffset = m_firstVisibleOffset;
+    for (auto it = m_items.cbegin(); it != m_items.cend(); ++it) {
+        placePage(it.key());
+    }
+    updateSceneRect();
+    if (anchor >= 0) {
+        const auto pageHeight = static_cast<float>(m_layout.end(anchor) - m_layout.start(anchor));
+        verticalScrollBar()->setValue(m_layout.start(anchor) + static_cast<int>(anchorOffset * pageHeight));
+    }
+    setPagesVisibility();
+}
+
+auto View::probeImages(const QStringList &files, const QString &archiveFile,
+                       int first, int last, int threadCount, const Worker::Token &token) -> std::vector<ProbedImage>
+{
+    std::vector<ProbedImage> images(std::max(0, last - first));
+    const int count = last - first;
+    if (count <= 0) {
+        return images;
+    }
+
+    // every thread reads a contiguous batch through its own file or archive handle
+    threadCount = std::clamp(count / MinProbeBatch, 1, std::max(1, threadCount));
+    const int batch = (count + threadCount - 1) / threadCount;
+    std::vector<std::unique_ptr<KArchive>> ownArchives;
+    if (!archives) {
+        archives = &ownArchives;
+    }
+    archives->resize(std::max(archives->size(), static_cast<size_t>((count + batch - 1) / batch)));
+    QList<QThread *> threads;
+    for (int begin = first + batch; begin < last; begin += batch) {
+        const int end = std::min(last, begin + batch);
+        ProbedImage *out = images.data() + (begin - first);
+        std::unique_ptr<KArchive> *archive = &(*archives)[(begin - first) / batch];
+        QThread *thread = QThread::create([files, archiveFile, begin, end, out, token, archive]() {
+            probeBatch(files, archiveFile, begin, end, out, token, archive);
+        });
+        thread->setObjectName(QStringLiteral("probe%1").arg((begin - first) / batch));
+        thread->start();
+        threads.append(thread);
+    }
+    // the first batch is probed on this thread
+    probeBatch(files, archiveFile, first, std::min(last, first + batch), images.data(), token, &archives->front());
+
+    for (QThread *thread : std::as_const(threads)) {
+        thread->wait();
+        delete thread;
+    }
+    return images;
+}
+
+// images[0] receives files[first]
+void View::probeBatch(const QStringList &files, const QString &archiveFile, int first, int last,
+                      ProbedImage *images, const Worker::Token &token, std::unique_ptr<KArchive> *archive)
+{
+    if (!archiveFile.isEmpty() && !*archive) {
+        archive->reset(Extractor::openArchive(archiveFile));
+        if (!*archive) {
+            return;
+        }
+    }
+
     QFileInfo fi;
     QScopedPointer<QIODevice> dev;
     QImageReader imageReader;
     imageReader.setAutoTransform(true);
-    int i {0};
-    for (auto &_file : m_files) {
+    for (int i = first; i < last; i++) {
+        // stopProbing waits for this, at most one image more
+        if (token && token->load()) {
+            return;
+        }
+        const QString &_file = files.at(i);
         fi.setFile(_file);
         imageReader.setFormat(fi.suffix().toUtf8());
-        if (m_loadFromMemory) {
-            const KArchiveFile *entry = m_archive->directory()->file(_file);
+        if (*archive) {
+            const KArchiveFile *entry = (*archive)->directory()->file(_file);
             if (!entry) {
                 continue;
             }
@@ -220,138 +592,433 @@ void View::createPages()
             continue;
         }
 
+        // pages are shown with their exif orientation applied
         QSize pageSize = imageReader.size();
         if (imageReader.transformation() & QImageIOHandler::TransformationRotate90) {
             pageSize.transpose();
         }
         if (!pageSize.isValid()) {
-            const QImage i = imageReader.read();
-            if (!i.isNull()) {
-                pageSize = i.size();
+            const QImage image = imageReader.read();
+            if (!image.isNull()) {
+                pageSize = image.size();
             }
         }
         if (pageSize.isValid()) {
-            Page *p = new Page(imageReader.size());
-            p->setNumber(i);
-            p->setFilename(_file);
-            p->setView(this);
-
-            m_pages.append(p);
-            m_scene->addItem(p);
+            images[i - first].size = pageSize;
         }
-        ++i;
     }
-    m_start.resize(m_pages.size());
-    m_end.resize(m_pages.size());
 }
 
 void View::calculatePageSizes()
 {
-    int pageYCoordinate = 0;
-    for (int i = 0; i < m_pages.count(); i++) {
-        Page *p = m_pages.at(i);
-        p->calculateScaledSize();
+    std::vector<QSize> &sizes = m_table.scaledSize;
+    for (int i = 0; i < m_table.count(); i++) {
+        sizes[i] = calculateScaledSize(i);
+    }
+    m_layout.setSizes(sizes, MangaReaderSettings::pageSpacing());
+
+    for (auto it = m_items.cbegin(); it != m_items.cend(); ++it) {
+        placePage(it.key());
+    }
+    updateSceneRect();
+}
+
+void View::updatePageSize(int number)
+{
+    m_table.scaledSize[number] = calculateScaledSize(number);
+    m_layout.setSize(number, m_table.scaledSize[number]);
+
+    // pages without an item are placed when they get one
+    for (auto it = m_items.cbegin(); it != m_items.cend(); ++it) {
+        placePage(it.key());
+    }
+    updateSceneRect();
+}
+
+auto View::calculateScaledSize(int number) const -> QSize
+{
+    int maxWidth = MangaReaderSettings::maxWidth();
+    bool fitWidth = MangaReaderSettings::fitWidth();
+    bool fitHeight = MangaReaderSettings::fitHeight();
+    bool upScale = MangaReaderSettings::upScale();
+    int viewWidth = width() - (verticalScrollBar()->width() + 10);
+    int viewHeight = height();
+    int imageWidth = m_table.sourceSize[number].width();
+    int imageHeight = m_table.sourceSize[number].height();
+    // files that couldn't be read
+    if (imageWidth <= 0 || imageHeight <= 0) {
+        return {0, 0};
+    }
+
+    int availableWidth = viewWidth < maxWidth ? viewWidth : maxWidth;
+
+    double ratio = 1.0;
+    if (fitHeight || fitWidth) {
+        double hRatio = fitHeight ? static_cast<double>(viewHeight) / imageHeight : 9999.0;
+        double wRatio = fitWidth ? static_cast<double>(availableWidth) / imageWidth : 9999.0;
+        ratio = hRatio < wRatio ? hRatio : wRatio;
+    }
+
+    if (ratio > 1.0 && !upScale) {
+        ratio = 1.0;
+    }
+
+    QSize scaledSize(static_cast<qint64>(std::ceil(imageWidth * ratio)),
+                     static_cast<qint64>(std::ceil(imageHeight * ratio)));
+
+    const double zoom = m_table.zoom[number];
+    if (zoom != 1.0) {
+        scaledSize = QSize(static_cast<qint64>(std::ceil(scaledSize.width() * zoom)),
+                           static_cast<qint64>(std::ceil(scaledSize.height() * zoom)));
+    }
+    return scaledSize;
+}
+
+void View::placePage(int number)
+{
+    Page *item = m_items.value(number);
+    if (!item) {
+        return;
+    }
+    const QSize &size = m_table.scaledSize[number];
+    item->setSize(size);
+    item->setPos((viewport()->width() - size.width()) / 2, m_layout.start(number));
+}
 
-        const int x = (viewport()->width() - p->scaledSize().width()) / 2;
-        p->setPos(x, pageYCoordinate);
+void View::updateSceneRect()
+{
+    // same as the items bounding rect, without visiting the items
+    const int width = m_layout.maxWidth();
+    m_scene->setSceneRect((viewport()->width() - width) / 2, 0, width, m_layout.height());
+}
 
-        int height = p->scaledSize().height();
+void View::updatePage(int number)
+{
+    if (m_stripRenderer) {
+        viewport()->update(mapFromScene(pageRect(number)).boundingRect());
+    } else if (Page *item = m_items.value(number)) {
+        item->update();
+    }
+}
 
-        m_start[i] = pageYCoordinate;
-        m_end[i] = pageYCoordinate + height;
-        pageYCoordinate += height + MangaReaderSettings::pageSpacing();
+auto View::pageRect(int number) const -> QRectF
+{
+    const QSize &size = m_table.scaledSize[number];
+    return {static_cast<qreal>((viewport()->width() - size.width()) / 2), static_cast<qreal>(m_layout.start(number)),
+            static_cast<qreal>(size.width()), static_cast<qreal>(size.height())};
+}
+
+void View::setStripRenderer(bool strip)
+{
+    if (strip == m_stripRenderer) {
+        return;
+    }
+    m_stripRenderer = strip;
+    updateItems();
+    viewport()->update();
+}
+
+void View::paintStrip(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), backgroundBrush());
+
+    // blit the cached images of the pages in the exposed area, no scene involved
+    const QRectF exposed = mapToScene(event->rect()).boundingRect();
+    for (int i = m_layout.pageAt(exposed.top()); i < m_table.count() && m_layout.start(i) < exposed.bottom(); i++) {
+        const QImage image = m_cache->scaled(i);
+        if (image.isNull()) {
+            continue;
+        }
+        const QRectF rect = pageRect(i);
+        painter.save();
+        painter.translate(mapFromScene(rect.topLeft()));
+        Page::paintImage(&painter, image, exposed.translated(-rect.topLeft()));
+        painter.restore();
+    }
+}
+
+void View::updateItems()
+{
+    // the load window and one page on each side of it get an item
+    int first = 0;
+    int last = -1;
+    // the strip renderer draws the pages itself
+    if (m_windowFirst >= 0 && !m_stripRenderer) {
+        first = std::max(0, m_windowFirst - 1);
+        last = std::min(m_windowLast + 1, m_table.count() - 1);
+    }
+
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (it.key() < first || it.key() > last) {
+            releaseItem(it.value());
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
     }
+    for (int i = first; i <= last; i++) {
+        if (m_items.contains(i)) {
+            continue;
+        }
+        Page *item = nullptr;
+        if (!m_freeItems.isEmpty()) {
+            item = m_freeItems.takeLast();
+        } else {
+            item = new Page(this);
+            m_scene->addItem(item);
+        }
+        item->setNumber(i);
+        m_items.insert(i, item);
+        placePage(i);
+        item->show();
+    }
+}
 
-    m_scene->setSceneRect(m_scene->itemsBoundingRect());
+void View::releaseItem(Page *item)
+{
+    item->hide();
+    item->setNumber(-1);
+    m_freeItems.append(item);
 }
 
 void View::setPagesVisibility()
 {
     const int vy1 = verticalScrollBar()->value();
-//    const int vy2 = vy1 + viewport()->height();
+    const int vy2 = vy1 + viewport()->height();
 
+    // pages are laid out top to bottom, so only the pages from the first one
+    // ending below the top of the viewport need to be checked
     m_firstVisible = -1;
     m_firstVisibleOffset = 0.0F;
+    int lastVisible = -1;
+    for (int i = m_layout.pageAt(vy1); i < m_table.count() && m_layout.start(i) < vy2; i++) {
+        if (!isInView(m_layout.start(i), m_layout.end(i))) {
+            continue;
+        }
+        if (m_firstVisible < 0) {
+            m_firstVisible = i;
+            // hidden portion (%) of page
+            m_firstVisibleOffset = static_cast<float>(vy1 - m_layout.start(i)) / static_cast<float>(m_table.scaledSize[i].height());
+        }
+        lastVisible = i;
+    }
 
-    for (int i = 0; i < m_pages.count(); i++) {
-        // page is visible on the screen but its image not loaded
-        auto page = m_pages.at(i);
-        int pageNumber = page->number();
-
-        if (isInView(m_start[pageNumber], m_end[pageNumber])) {
-            if (page->isImageDeleted()) {
-                addRequest(pageNumber);
-            }
-            if (m_firstVisible < 0) {
-                m_firstVisible = pageNumber;
-                // hidden portion (%) of page
-                m_firstVisibleOffset = static_cast<float>(vy1 - m_start[pageNumber]) / static_cast<float>(page->scaledSize().height());
-            }
-        } else {
-            // page is not visible but its image is loaded
-            bool isPrevPageInView = false;
-            if (i > 0) {
-                isPrevPageInView = isInView(m_start.at(i - 1), m_end.at(i - 1));
-            }
-            bool isNextPageInView = false;
-            if (m_start.at(i) != m_start.last()) {
-                isNextPageInView = isInView(m_start.at(i + 1), m_end.at(i + 1));
-            }
+    // the visible pages and the one after them are loaded
+    int windowFirst = -1;
+    int windowLast = -1;
+    if (m_firstVisible >= 0) {
+        windowFirst = m_firstVisible;
+        windowLast = std::min(lastVisible + 1, m_table.count() - 1);
+    }
 
-            if (!page->isImageDeleted()) {
-                // delete page image unless it is before or after a page that is in view
-                if (!(isPrevPageInView || isNextPageInView)) {
-                    page->deleteImage();
-                    delRequest(pageNumber);
-                }
-            } else { // page is not visible and its image not loaded
-                // if previous page is visible load current page image too
-                if (isPrevPageInView) {
-                    addRequest(pageNumber);
-                } else {
-                    delRequest(pageNumber);
-                }
-            }
+    // pages that left the window don't need their pending requests anymore,
+    // loaded pages stay in the cache until its budget is exceeded
+    for (int i = m_windowFirst; i >= 0 && i <= m_windowLast && i < m_table.count(); i++) {
+        if ((i < windowFirst || i > windowLast) && isImageDeleted(i)) {
+            delRequest(i);
         }
     }
+    for (int i = windowFirst; i >= 0 && i <= windowLast; i++) {
+        if (isImageDeleted(i)) {
+            addRequest(i);
+        }
+    }
+    m_windowFirst = windowFirst;
+    m_windowLast = windowLast;
+    updateItems();
+
+    m_cache->setVisibleRange(m_firstVisible, lastVisible);
+    Worker::instance()->setVisibleRange(m_firstVisible, lastVisible);
 }
 
 void View::addRequest(int number)
 {
-    if (hasRequest(number)) {
+    if (hasRequest(number) || !m_table.available[number]) {
         return;
     }
-    m_requestedPages.append(number);
-    QString filename = m_pages.at(number)->filename();
-    if (m_loadFromMemory) {
-        Q_EMIT requestMemoryImage(number, m_archive->directory()->file(filename)->data());
+    // the decoded image is still cached, it only has to be scaled
+    if (!m_cache->image(number).isNull()) {
+        m_table.state[number] = PageTable::State::Decoded;
+        redrawPage(number);
+        return;
+    }
+    requestImage(number);
+}
+
+void View::requestImage(int number)
+{
+    // the size of a page that wasn't probed yet is a guess, decode it at full size
+    const QSize size = m_table.probed[number] ? m_table.scaledSize[number] : QSize();
+    const QByteArray data = m_cache->data(number);
+    Worker::Token token;
+    if (!data.isEmpty()) {
+        token = Worker::instance()->requestImageData(m_generation, number, data, size);
+    } else if (m_loadFromMemory) {
+        token = Worker::instance()->requestMemoryImage(m_generation, number, m_manga,
+                                                       filename(number), size);
     } else {
-        Q_EMIT requestDriveImage(number, filename);
+        token = Worker::instance()->requestDriveImage(m_generation, number, filename(number), size);
     }
+    m_table.requestToken[number] = token;
+    m_table.state[number] = PageTable::State::Requested;
 }
 
 auto View::hasRequest(int number) const -> bool
 {
-    return m_requestedPages.indexOf(number) >= 0;
+    // decoding or waiting for the resize
+    const PageTable::State state = m_table.state[number];
+    return state == PageTable::State::Requested || state == PageTable::State::Decoded;
 }
 
 void View::delRequest(int number)
 {
-    int idx = m_requestedPages.indexOf(number);
-    if (idx >= 0) {
-        m_requestedPages.removeAt(idx);
+    Worker::Token &token = m_table.requestToken[number];
+    if (token) {
+        token->store(true);
+        token.reset();
+    }
+    if (hasRequest(number)) {
+        m_table.state[number] = PageTable::State::Idle;
     }
 }
 
-void View::onImageReady(const QImage &image, int number)
+void View::clearRequests()
 {
-    // when loading another manga it can happen that the number returned by the thread
-    // is bigger than the total number of images the current manga has
-    // resulting in an index out of range crash
-    if (number > m_pages.size() - 1) {
+    for (int i = 0; i < m_table.count(); i++) {
+        delRequest(i);
+    }
+}
+
+auto View::pageState(int number) const -> PageTable::State
+{
+    return m_table.state[number];
+}
+
+void View::reloadImage(int number)
+{
+    delRequest(number);
+    requestImage(number);
+}
+
+auto View::filename(int number) const -> const QString &
+{
+    return m_files.at(m_table.file[number]);
+}
+
+auto View::isImageDeleted(int number) const -> bool
+{
+    return !m_cache->hasScaled(number);
+}
+
+void View::deletePageImage(int number)
+{
+    Worker::Token &token = m_table.resizeToken[number];
+    if (token) {
+        token->store(true);
+        token.reset();
+    }
+    // the decoded source stays cached so the page can be scaled again without decoding it
+    m_cache->remove(number, PageCache::Scaled);
+    m_table.scaledImageSize[number] = QSize();
+}
+
+void View::setPageImage(int number, const QImage &image, const QSize &decodeSize)
+{
+    m_cache->insertImage(number, image);
+    m_table.decodeSize[number] = decodeSize;
+    m_table.reloadSize[number] = QSize();
+    redrawPage(number, image);
+}
+
+void View::redrawPage(int number, const QImage &decoded)
+{
+    const QSize scaledSize = calculateScaledSize(number);
+    m_table.scaledSize[number] = scaledSize;
+    Worker::Token &resizeToken = m_table.resizeToken[number];
+    // already being resized to this size
+    if (resizeToken && m_table.resizeSize[number] == scaledSize) {
         return;
     }
-    m_pages.at(number)->setImage(image);
+    // a newer size supersedes the resize that is still queued or running
+    if (resizeToken) {
+        resizeToken->store(true);
+        resizeToken.reset();
+    }
+    if (!isImageDeleted(number) && m_table.scaledImageSize[number] == scaledSize) {
+        return;
+    }
+    const QImage image = decoded.isNull() ? m_cache->image(number) : decoded;
+    if (image.isNull()) {
+        // the source was dropped after scaling, decode it again for the new size
+        if (!isImageDeleted(number) && m_table.reloadSize[number] != scaledSize) {
+            m_table.reloadSize[number] = scaledSize;
+            reloadImage(number);
+        } else if (m_table.state[number] == PageTable::State::Decoded) {
+            // the source was evicted before it was scaled, nothing else would request it again
+            reloadImage(number);
+        }
+        return;
+    }
+    // the image was decoded for a smaller size, get a sharper one from the file;
+    // until it arrives the current image is scaled up
+    const QSize &decodeSize = m_table.decodeSize[number];
+    if (image.width() < scaledSize.width() && image.width() < m_table.sourceSize[number].width()
+            && decodeSize.isValid() && decodeSize.width() < scaledSize.width()) {
+        reloadImage(number);
+    }
+    // decoded at the final size, no resampling needed
+    if (image.size() == scaledSize) {
+        setScaledImage(number, image, scaledSize);
+        return;
+    }
+    m_table.resizeSize[number] = scaledSize;
+    resizeToken = Worker::instance()->requestResize(m_generation, number, image, scaledSize);
+}
+
+void View::setScaledImage(int number, const QImage &image, const QSize &size)
+{
+    // resized for a size that is no longer wanted
+    if (size != m_table.scaledSize[number]) {
+        return;
+    }
+    m_table.resizeToken[number].reset();
+    m_table.requestToken[number].reset();
+    m_table.scaledImageSize[number] = size;
+    // set before inserting, the cache may evict the image right away
+    m_table.state[number] = PageTable::State::Scaled;
+    m_cache->insertScaled(number, image);
+    if (MangaReaderSettings::sourceImages() == MangaReaderSettings::EnumSourceImages::DropAfterScaling) {
+        m_cache->remove(number, PageCache::Source);
+    }
+    updatePage(number);
+}
+
+void View::onImageReady(const QImage &image, const QByteArray &data, const QSize &size, int number, int generation)
+{
+    // results from a previous manga or for pages that are no longer wanted
+    if (generation != m_generation || m_table.state[number] != PageTable::State::Requested) {
+        return;
+    }
+    m_table.requestToken[number].reset();
+    m_table.state[number] = PageTable::State::Decoded;
+    m_cache->insertData(number, data);
+    // decoded before the background probe got to it, the image has the real size
+    if (!m_table.probed[number]) {
+        m_table.probed[number] = true;
+        setSourceSize(number, image.size());
+        relayout();
+    } else if (differentShape(image.size(), m_table.sourceSize[number])) {
+        // the size came from ComicInfo or the cache and is wrong (e.g. the file was replaced),
+        // the cache is written again with the real one
+        setSourceSize(number, image.size());
+        relayout();
+        m_metadataSaved = false;
+        if (std::find(m_table.probed.cbegin(), m_table.probed.cend(), false) == m_table.probed.cend()) {
+            saveMetadata();
+        }
+    }
+    setPageImage(number, image, size);
     //    calculatePageSizes();
     if (m_startPage > 0) {
         goToPage(m_startPage);
@@ -360,10 +1027,13 @@ void View::onImageReady(const QImage &image, int number)
     setPagesVisibility();
 }
 
-void View::onImageResized(const QImage &image, int number)
+void View::onImageResized(const QImage &image, const QSize &size, int number, int generation)
 {
-    m_pages.at(number)->redraw(image);
-    m_scene->setSceneRect(m_scene->itemsBoundingRect());
+    if (generation != m_generation) {
+        return;
+    }
+    // the page keeps its size, only its image changes
+    setScaledImage(number, image, size);
 }
 
 void View::onScrollBarRangeChanged(int x, int y)
@@ -372,8 +1042,8 @@ void View::onScrollBarRangeChanged(int x, int y)
     Q_UNUSED(y)
     if (m_firstVisible >= 0)
     {
-        auto pageHeight = static_cast<float>(m_end[m_firstVisible] - m_start[m_firstVisible]);
-        int offset = m_start[m_firstVisible] + static_cast<int>(m_firstVisibleOffset * pageHeight);
+        auto pageHeight = static_cast<float>(m_layout.end(m_firstVisible) - m_layout.start(m_firstVisible));
+        int offset = m_layout.start(m_firstVisible) + static_cast<int>(m_firstVisibleOffset * pageHeight);
         verticalScrollBar()->setValue(offset);
     }
 }
@@ -387,7 +1057,9 @@ void View::scrollContentsBy(int dx, int dy)
 void View::refreshPages()
 {
     // clear requested pages so they are resized too
-    m_requestedPages.clear();
+    clearRequests();
+    m_cache->setBudget(static_cast<qint64>(MangaReaderSettings::cacheSize()) * 1024 * 1024);
+    setStripRenderer(MangaReaderSettings::renderer() == MangaReaderSettings::EnumRenderer::Strip);
     if (MangaReaderSettings::useCustomBackgroundColor()) {
         setBackgroundBrush(MangaReaderSettings::backgroundColor());
     } else {
@@ -395,10 +1067,10 @@ void View::refreshPages()
     }
 
     if (maximumWidth() != MangaReaderSettings::maxWidth()) {
-        for (Page *page: std::as_const(m_pages)) {
-            page->setZoom(m_globalZoom);
-            if (!page->isImageDeleted()) {
-                page->deleteImage();
+        for (int i = 0; i < m_table.count(); i++) {
+            m_table.zoom[i] = m_globalZoom;
+            if (!isImageDeleted(i)) {
+                deletePageImage(i);
             }
         }
     }
@@ -415,14 +1087,14 @@ auto View::isInView(int imgTop, int imgBot) -> bool
 
 void View::resizeEvent(QResizeEvent *e)
 {
-    if (m_pages.isEmpty()) {
+    if (m_table.count() == 0) {
         return;
     }
     if (MangaReaderSettings::useResizeTimer()) {
         m_resizeTimer->start();
     } else {
-        for (Page *p : std::as_const(m_pages)) {
-            p->redrawImage();
+        for (int i = 0; i < m_table.count(); i++) {
+            redrawPage(i);
         }
         calculatePageSizes();
     }
@@ -447,12 +1119,10 @@ void View::mouseReleaseEvent(QMouseEvent *event)
     }
 
     QPointF position = mapFromGlobal(event->globalPosition());
-    Page *page;
-    if (QGraphicsItem *item = itemAt(position.toPoint())) {
-        page = qgraphicsitem_cast<Page *>(item);
-        togglePageZoom(page);
+    const int number = pageAtPosition(position.toPoint());
+    if (number >= 0) {
+        togglePageZoom(number);
     }
-    calculatePageSizes();
 }
 
 void View::mouseMoveEvent(QMouseEvent *event)
@@ -481,29 +1151,39 @@ void View::wheelEvent(QWheelEvent *event)
 void View::contextMenuEvent(QContextMenuEvent *event)
 {
     QPoint position = mapFromGlobal(event->globalPos());
-    Page *page;
-    if (QGraphicsItem *item = itemAt(position)) {
-        page = qgraphicsitem_cast<Page *>(item);
+    // items are recycled while scrolling, the actions keep the page number
+    const int number = pageAtPosition(position);
+    if (number >= 0) {
         auto menu = new QMenu();
-        menu->addSection(i18n("Page %1", page->number() + 1));
+        menu->addSection(i18n("Page %1", number + 1));
 
-        QString zoomActionText = page->isZoomToggled()
+        QString zoomActionText = m_table.zoomToggled[number]
                 ? i18n("Zoom Out")
                 : i18n("Zoom In");
-        QIcon zoomActionIcon = page->isZoomToggled()
+        QIcon zoomActionIcon = m_table.zoomToggled[number]
                 ? QIcon::fromTheme(u"zoom-out"_qs)
                 : QIcon::fromTheme(u"zoom-in"_qs);
+        const int generation = m_generation;
         menu->addAction(zoomActionIcon, zoomActionText, this, [=]() {
-            togglePageZoom(page);
-            calculatePageSizes();
+            if (generation == m_generation) {
+                togglePageZoom(number);
+            }
         });
 
         menu->addAction(QIcon::fromTheme(u"folder-bookmark"_qs), i18n("Set Bookmark"), this, [=] {
-            Q_EMIT addBookmark(page->number());
+            Q_EMIT addBookmark(number);
         });
 
         menu->addAction(QIcon::fromTheme(u"selection-make-bitmap-copy"_qs), i18n("Copy Image"), this, [=] {
-            QApplication::clipboard()->setImage(page->image());
+            if (generation != m_generation) {
+                return;
+            }
+            // the source may have been dropped after scaling
+            QImage image = m_cache->image(number);
+            if (image.isNull()) {
+                image = m_cache->scaled(number);
+            }
+            QApplication::clipboard()->setImage(image);
         });
         menu->popup(event->globalPos());
     }
@@ -529,6 +1209,16 @@ void View::setLoadFromMemory(bool newLoadFromMemory)
     m_loadFromMemory = newLoadFromMemory;
 }
 
+auto View::cache() const -> PageCache *
+{
+    return m_cache;
+}
+
+auto View::generation() const -> int
+{
+    return m_generation;
+}
+
 bool View::event(QEvent *event)
 {
     switch (event->type()) {
@@ -546,22 +1236,63 @@ bool View::event(QEvent *event)
     return QGraphicsView::event(event);
 }
 
+bool View::viewportEvent(QEvent *event)
+{
+    if (event->type() == QEvent::Paint && m_stripRenderer) {
+        paintStrip(static_cast<QPaintEvent *>(event));
+        return true;
+    }
+    if (event->type() == QEvent::ToolTip && MangaReaderSettings::showMemoryUsage()) {
+        auto helpEvent = static_cast<QHelpEvent *>(event);
+        const int number = pageAtPosition(helpEvent->pos());
+        if (number >= 0) {
+            const KFormat format;
+            const auto state = QMetaEnum::fromType<PageTable::State>().valueToKey(static_cast<int>(m_table.state[number]));
+            const QString text = i18n("Page %1 (%8): %2\n"
+                                      "compressed %3, decoded %4, scaled %5\n"
+                                      "Page cache: %6 of %7",
+                                      number + 1,
+                                      format.formatByteSize(m_cache->bytes(number)),
+                                      format.formatByteSize(m_cache->bytes(number, PageCache::Compressed)),
+                                      format.formatByteSize(m_cache->bytes(number, PageCache::Source)),
+                                      format.formatByteSize(m_cache->bytes(number, PageCache::Scaled)),
+                                      format.formatByteSize(m_cache->size()),
+                                      format.formatByteSize(m_cache->budget()),
+                                      QLatin1String(state));
+            QToolTip::showText(helpEvent->globalPos(), text, viewport());
+            return true;
+        }
+    }
+    return QGraphicsView::viewportEvent(event);
+}
+
 void View::setArchive(KArchive *newArchive)
 {
     m_archive = newArchive;
 }
 
+auto View::pageAtPosition(const QPoint &position) const -> int
+{
+    // hit test against the layout, the strip renderer has no items
+    const QPointF scenePosition = mapToScene(position);
+    const int number = m_layout.pageAt(static_cast<int>(scenePosition.y()));
+    if (number >= m_table.count() || !pageRect(number).contains(scenePosition)) {
+        return -1;
+    }
+    return number;
+}
+
 void View::goToPage(int number)
 {
-    if (m_pages.isEmpty()) {
+    if (m_table.count() == 0) {
         return;
     }
-    verticalScrollBar()->setValue(m_start[number]);
+    verticalScrollBar()->setValue(m_layout.start(number));
 }
 
 auto View::imageCount() -> int
 {
-    return m_pages.count();
+    return m_table.count();
 }
 
 void View::setStartPage(int number)
@@ -579,6 +1310,11 @@ void View::setFiles(const QStringList &files)
     m_files = files;
 }
 
+void View::setPageSizes(const std::vector<QSize> &sizes)
+{
+    m_pageSizes = sizes;
+}
+
 void View::zoomIn()
 {
     m_globalZoom += 0.1;
@@ -597,16 +1333,17 @@ void View::zoomReset()
     refreshPages();
 }
 
-void View::togglePageZoom(Page *page)
+void View::togglePageZoom(int number)
 {
-    if (page->isZoomToggled()) {
-        auto zoom = page->zoom() < 1.3 ? 1.0 : page->zoom() - 0.3;
-        page->setZoom(zoom);
+    if (m_table.zoomToggled[number]) {
+        auto zoom = m_table.zoom[number] < 1.3 ? 1.0 : m_table.zoom[number] - 0.3;
+        m_table.zoom[number] = zoom;
     } else {
-        page->setZoom(page->zoom() + 0.3);
+        m_table.zoom[number] = m_table.zoom[number] + 0.3;
     }
-    page->setIsZoomToggled(!page->isZoomToggled());
-    page->redrawImage();
+    m_table.zoomToggled[number] = !m_table.zoomToggled[number];
+    redrawPage(number);
+    updatePageSize(number);
 }
 
 #include "moc_view.cpp"
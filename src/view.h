@@ -8,12 +8,18 @@
 #define VIEW_H
 
 #include <QGraphicsView>
+#include <QHash>
 #include <QObject>
 #include <KXMLGUIClient>
 
+#include "pagelayout.h"
+#include "pagetable.h"
+
 class KArchive;
 class Page;
+class PageCache;
 class QGraphicsScene;
+class QThread;
 class MainWindow;
 
 class View : public QGraphicsView, public KXMLGUIClient
@@ -22,7 +28,7 @@ class View : public QGraphicsView, public KXMLGUIClient
 
 public:
     View(MainWindow *parent);
-    ~View() = default;
+    ~View();
     void reset();
     void loadImages();
     void goToPage(int number);
@@ -30,17 +36,27 @@ public:
     void setStartPage(int number);
     const QString &manga() const;
     void setManga(const QString &manga);
+    // the files come from the manga folder and its subfolders
+    void setRecursive(bool recursive);
     void setFiles(const QStringList &files);
+    void setPageSizes(const std::vector<QSize> &sizes);
+    // the files are still being extracted, they become pages as fileExtracted() is called for them
+    void setExtracting(bool extracting);
+    auto isExtracting() const -> bool;
+    void fileExtracted(const QString &file);
+    void extractionFinished();
     void setArchive(KArchive *newArchive);
 
     void setLoadFromMemory(bool newLoadFromMemory);
+    auto pageState(int number) const -> PageTable::State;
+    auto cache() const -> PageCache *;
+    auto generation() const -> int;
 
     bool event(QEvent *event) override;
+    bool viewportEvent(QEvent *event) override;
 
 Q_SIGNALS:
     void imagesLoaded(int number);
-    void requestDriveImage(int number, const QString &path);
-    void requestMemoryImage(int number, const QByteArray &data);
     void currentImageChanged(int number);
     void doubleClicked();
     void mouseMoved(QMouseEvent *event);
@@ -48,23 +64,61 @@ Q_SIGNALS:
     void fileDropped(const QString &file);
 
 public Q_SLOTS:
-    void onImageReady(const QImage &image, int number);
-    void onImageResized(const QImage &image, int number);
+    void onImageReady(const QImage &image, const QByteArray &data, const QSize &size, int number, int generation);
+    void onImageResized(const QImage &image, const QSize &size, int number, int generation);
     void onScrollBarRangeChanged(int x, int y);
     void refreshPages();
     void zoomIn();
     void zoomOut();
     void zoomReset();
-    void togglePageZoom(Page *page);
+    void togglePageZoom(int number);
 
 private:
     void setupActions();
     void createPages();
+    void startProbing();
+    void stopProbing();
+    struct ProbedImage {
+        QSize size;
+    };
+    void onPagesProbed(int first, const std::vector<ProbedImage> &images);
+    void saveMetadata();
+    void setFileAvailable(int number);
+    void setSourceSize(int number, const QSize &size);
+    void relayout();
+    // stop early when token is set, the remaining images are left invalid;
+    // archives keeps the handles of the threads between calls, they are opened when missing
+    static auto probeImages(const QStringList &files, const QString &archiveFile,
+                            int first, int last, int threadCount, const Worker::Token &token = {},
+                            std::vector<std::unique_ptr<KArchive>> *archives = nullptr) -> std::vector<ProbedImage>;
+    static void probeBatch(const QStringList &files, const QString &archiveFile, int first, int last,
+                           ProbedImage *images, const Worker::Token &token, std::unique_ptr<KArchive> *archive);
     void calculatePageSizes();
+    void updatePageSize(int number);
+    auto calculateScaledSize(int number) const -> QSize;
+    void placePage(int number);
+    void updateSceneRect();
+    void updatePage(int number);
+    auto pageRect(int number) const -> QRectF;
+    void setStripRenderer(bool strip);
+    void paintStrip(QPaintEvent *event);
+    void updateItems();
+    void releaseItem(Page *item);
+    auto pageAtPosition(const QPoint &position) const -> int;
     void setPagesVisibility();
     void addRequest(int number);
+    void requestImage(int number);
     void delRequest(int number);
     auto hasRequest(int number) const -> bool;
+    void clearRequests();
+    void reloadImage(int number);
+    auto filename(int number) const -> const QString &;
+    auto isImageDeleted(int number) const -> bool;
+    void deletePageImage(int number);
+    void setPageImage(int number, const QImage &image, const QSize &decodeSize);
+    // decoded is the image that was just decoded, the cache may have evicted it already
+    void redrawPage(int number, const QImage &decoded = QImage());
+    void setScaledImage(int number, const QImage &image, const QSize &size);
     void scrollContentsBy(int dx, int dy) override;
     auto isInView  (int imgTop, int imgBot) -> bool;
     void resizeEvent(QResizeEvent *e) override;
@@ -79,17 +133,37 @@ private:
     QGraphicsScene  *m_scene{};
     QString          m_manga;
     QStringList      m_files;
-    QVector<Page*>   m_pages;
-    QVector<int>     m_start;
-    QVector<int>     m_end;
-    QVector<int>     m_requestedPages;
+    // sizes from the manga's metadata, invalid for the pages it doesn't describe
+    std::vector<QSize> m_pageSizes;
+    PageTable        m_table;
+    PageLayout       m_layout;
+    // items bound to the pages near the viewport, by page number
+    QHash<int, Page*> m_items;
+    QList<Page*>     m_freeItems;
+    // draw the pages straight onto the viewport instead of through the scene
+    bool             m_stripRenderer = false;
     int              m_startPage = 0;
+    // incremented for every loaded manga, results of older requests are discarded
+    int              m_generation = 0;
     int              m_firstVisible = -1;
     float            m_firstVisibleOffset = 0.0f;
+    // pages that were visible or preloaded on the last visibility update
+    int              m_windowFirst = -1;
+    int              m_windowLast = -1;
     double           m_globalZoom = 1.0;
     QTimer          *m_resizeTimer{};
+    // probes the sizes of the pages that were shown with an estimated size
+    QThread         *m_probeThread{};
+    Worker::Token    m_probeToken;
+    // the page sizes are in the metadata cache
+    bool             m_metadataSaved{false};
+    PageCache       *m_cache{};
     KArchive        *m_archive {};
     bool m_loadFromMemory {false};
+    bool m_extracting {false};
+    bool m_recursive {false};
+    // page number of each file while extracting
+    QHash<QString, int> m_fileNumbers;
 };
 
 #endif // VIEW_H
@@ -6,31 +6,350 @@
 
 #include "worker.h"
 
+#include <QBuffer>
+#include <QFile>
 #include <QImage>
+#include <QImageReader>
 #include <QPainter>
+#include <QThread>
 
-void Worker::processDriveImageRequest(int number, const QString &path)
+#include <KArchive>
+
+#include <algorithm>
+
+#include "extractor.h"
+#include "grayscale.h"
+#include "zipreader.h"
+
+// largest channel difference still treated as gray, absorbs jpeg chroma noise in scanned pages
+static constexpr int GrayscaleTolerance = 12;
+// requests whose entries are read ahead while one is decoded
+static constexpr int ReadaheadRequests = 2;
+
+Worker::~Worker()
+{
+    stop();
+}
+
+void Worker::start(int threadCount)
+{
+    threadCount = std::max(1, threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        QThread *thread = QThread::create([this]() {
+            run();
+        });
+        thread->setObjectName(QStringLiteral("decoder%1").arg(i));
+        thread->start();
+        m_threads.append(thread);
+    }
+}
+
+void Worker::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        // pending requests are kept so they survive a change of the thread count
+        m_quit = true;
+        m_condition.wakeAll();
+    }
+    for (QThread *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+
+    QMutexLocker locker(&m_mutex);
+    m_quit = false;
+}
+
+void Worker::setThreadCount(int threadCount)
+{
+    if (std::max(1, threadCount) == m_threads.count()) {
+        return;
+    }
+    stop();
+    start(threadCount);
+}
+
+auto Worker::requestDriveImage(int generation, int number, const QString &path, const QSize &size) -> Token
+{
+    Request request;
+    request.job = Job::LoadFromDrive;
+    request.generation = generation;
+    request.number = number;
+    request.path = path;
+    request.size = size;
+    return enqueue(request);
+}
+
+auto Worker::requestMemoryImage(int generation, int number, const QString &archiveFile,
+                                const QString &entry, const QSize &size) -> Token
+{
+    Request request;
+    request.job = Job::LoadFromMemory;
+    request.generation = generation;
+    request.number = number;
+    request.path = archiveFile;
+    request.entry = entry;
+    request.size = size;
+    return enqueue(request);
+}
+
+auto Worker::requestImageData(int generation, int number, const QByteArray &data, const QSize &size) -> Token
+{
+    Request request;
+    request.job = Job::LoadFromData;
+    request.generation = generation;
+    request.number = number;
+    request.data = data;
+    request.size = size;
+    return enqueue(request);
+}
+
+auto Worker::requestResize(int generation, int number, const QImage &image, const QSize &size) -> Token
+{
+    Request request;
+    request.job = Job::Resize;
+    request.generation = generation;
+    request.number = number;
+    request.image = image;
+    request.size = size;
+    return enqueue(request);
+}
+
+void Worker::setVisibleRange(int first, int last)
+{
+    QMutexLocker locker(&m_mutex);
+    m_firstVisible = first;
+    m_lastVisible = last;
+}
+
+void Worker::setResizeFilter(Resampler::Filter filter)
+{
+    m_resizeFilter = filter;
+}
+
+void Worker::setDetectGrayscale(bool detect)
+{
+    m_detectGrayscale = detect;
+}
+
+auto Worker::enqueue(Request request) -> Token
 {
-    const QString filename = path;
-    QImage image;
-    if (image.load(filename)) {
-        Q_EMIT imageReady(image, number);
+    Token token = std::make_shared<std::atomic_bool>(false);
+    request.token = token;
+
+    QMutexLocker locker(&m_mutex);
+    request.sequence = m_sequence++;
+    m_queue.push_back(std::move(request));
+    m_condition.wakeOne();
+    return token;
+}
+
+auto Worker::takeRequest(Request &request) -> bool
+{
+    QMutexLocker locker(&m_mutex);
+    for (;;) {
+        // drop cancelled requests before anything is read or decoded
+        m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(), [](const Request &r) {
+            return r.token->load();
+        }), m_queue.end());
+
+        if (m_quit) {
+            return false;
+        }
+        if (!m_queue.empty()) {
+            break;
+        }
+        m_condition.wait(&m_mutex);
+    }
+
+    auto it = std::min_element(m_queue.begin(), m_queue.end(), [this](const Request &a, const Request &b) {
+        return isBefore(a, b);
+    });
+    request = std::move(*it);
+    m_queue.erase(it);
+
+    // the pages that follow in the view's order, not in the archive's
+    request.upcoming.clear();
+    if (request.job == Job::LoadFromMemory) {
+        std::vector<const Request *> next;
+        for (const Request &r : m_queue) {
+            if (r.job == Job::LoadFromMemory && r.path == request.path) {
+                next.push_back(&r);
+            }
+        }
+        const int count = std::min(static_cast<int>(next.size()), ReadaheadRequests);
+        std::partial_sort(next.begin(), next.begin() + count, next.end(), [this](const Request *a, const Request *b) {
+            return isBefore(*a, *b);
+        });
+        for (int i = 0; i < count; ++i) {
+            request.upcoming.append(next[i]->entry);
+        }
+    }
+    return true;
+}
+
+// visible pages first, then the ones closest to the viewport,
+// requests at the same distance are served in the order they came in
+auto Worker::isBefore(const Request &a, const Request &b) const -> bool
+{
+    const int da = distance(a.number);
+    const int db = distance(b.number);
+    return da != db ? da < db : a.sequence < b.sequence;
+}
+
+auto Worker::distance(int number) const -> int
+{
+    if (m_firstVisible < 0) {
+        return 0;
+    }
+    if (number < m_firstVisible) {
+        return m_firstVisible - number;
+    }
+    if (number > m_lastVisible) {
+        return number - m_lastVisible;
+    }
+    return 0;
+}
+
+void Worker::run()
+{
+    // each decoding thread reads entries through its own archive handle
+    std::unique_ptr<KArchive> archive;
+    Request request;
+    while (takeRequest(request)) {
+        if (request.job == Job::Resize) {
+            processImageResize(request);
+        } else {
+            processImageRequest(request, archive);
+        }
+        // release the shared image data before waiting for the next request
+        request = Request();
     }
 }
 
-void Worker::processMemoryImageRequest(int number, const QByteArray &data)
+void Worker::processImageRequest(const Request &request, std::unique_ptr<KArchive> &archive)
 {
-    QImage image = QImage::fromData(data);
-    if (!image.isNull()) {
-        Q_EMIT imageReady(image, number);
+    QByteArray data;
+    bool mapped = false;
+    switch (request.job) {
+    case Job::LoadFromDrive: {
+        QFile file(request.path);
+        if (file.open(QIODevice::ReadOnly)) {
+            data = file.readAll();
+        }
+        break;
+    }
+    case Job::LoadFromMemory:
+        data = readArchiveEntry(archive, request.path, request.entry, request.upcoming, &mapped);
+        break;
+    case Job::LoadFromData:
+        data = request.data;
+        break;
+    case Job::Resize:
+        return;
+    }
+
+    // the page may have scrolled away while the file was read
+    if (data.isEmpty() || request.token->load()) {
+        return;
+    }
+
+    QBuffer buffer(&data);
+    QImageReader reader(&buffer);
+    // the same orientation the pages were probed with
+    reader.setAutoTransform(true);
+    QImage image = readImage(reader, request.size);
+    // colorless pages are kept at 8 bits per pixel through the cache and the resampler
+    if (m_detectGrayscale && !image.isNull()) {
+        image = Grayscale::simplified(image, GrayscaleTolerance);
+    }
+    if (!image.isNull() && !request.token->load()) {
+        // a mapped entry points into the archive file, it's cheap to read again
+        // and must not outlive the archive, so it isn't kept by the cache
+        Q_EMIT imageReady(image, mapped ? QByteArray() : data, request.size, request.number, request.generation);
     }
 }
 
-void Worker::processImageResize(const QImage &image, const QSize &size, int number)
+auto Worker::readImage(QImageReader &reader, const QSize &displaySize) -> QImage
 {
-    auto scaledImage = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    // the reader scales before it applies the exif rotation
+    QSize size = displaySize;
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+        size.transpose();
+    }
+    const QSize sourceSize = reader.size();
+    if (!size.isValid() || !sourceSize.isValid()
+            || size.width() >= sourceSize.width() || size.height() >= sourceSize.height()) {
+        return reader.read();
+    }
+
+    const QByteArray format = reader.format();
+    if (format == "jpeg" || format == "jpg") {
+        // libjpeg scales by 1/2, 1/4 or 1/8 while decoding (DCT scaling),
+        // use the smallest factor that doesn't go below the wanted size
+        int denominator = 1;
+        while (denominator < 8
+               && sourceSize.width() / (denominator * 2) >= size.width()
+               && sourceSize.height() / (denominator * 2) >= size.height()) {
+            denominator *= 2;
+        }
+        if (denominator > 1) {
+            // same rounding as libjpeg, so the handler doesn't resample the result
+            reader.setScaledSize(QSize((sourceSize.width() + denominator - 1) / denominator,
+                                       (sourceSize.height() + denominator - 1) / denominator));
+        }
+    } else if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(size);
+    }
+    return reader.read();
+}
 
-    Q_EMIT imageResized(scaledImage, number);
+void Worker::processImageResize(const Request &request)
+{
+    const QSize size = request.image.size().scaled(request.size, Qt::KeepAspectRatio);
+    auto scaledImage = Resampler::scaled(request.image, size, m_resizeFilter);
+
+    if (!request.token->load()) {
+        Q_EMIT imageResized(scaledImage, request.size, request.number, request.generation);
+    }
+}
+
+auto Worker::readArchiveEntry(std::unique_ptr<KArchive> &archive,
+                              const QString &archiveFile,
+                              const QString &entry,
+                              const QStringList &upcoming,
+                              bool *mapped) -> QByteArray
+{
+    if (!archive || archive->fileName() != archiveFile) {
+        archive.reset(Extractor::openArchive(archiveFile));
+        if (!archive) {
+            return {};
+        }
+    }
+
+    const KArchiveFile *file = archive->directory()->file(entry);
+    if (!file) {
+        return {};
+    }
+    // stored zip entries are decoded straight from the mapped file
+    if (auto reader = dynamic_cast<ZipReader *>(archive.get())) {
+        // the next pages are read from disk while this one is decoded
+        std::vector<qint64> next;
+        for (const QString &name : upcoming) {
+            if (const KArchiveFile *upcomingFile = archive->directory()->file(name)) {
+                next.push_back(upcomingFile->position());
+            }
+        }
+        reader->willNeed(next);
+        QByteArray data = reader->entryView(file->position());
+        if (!data.isEmpty()) {
+            *mapped = true;
+            return data;
+        }
+    }
+    return file->data();
 }
 
 auto Worker::instance() -> Worker *
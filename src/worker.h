@@ -7,14 +7,28 @@
 #ifndef WORKER_H
 #define WORKER_H
 
+#include <QImage>
+#include <QMutex>
 #include <QObject>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "resampler.h"
+
+class KArchive;
+class QImageReader;
+class QThread;
 
 class Worker : public QObject
 {
     Q_OBJECT
 public:
     Worker() = default;
-    ~Worker() = default;
+    ~Worker();
 
     Worker(const Worker &) = delete;
     Worker &operator=(const Worker &) = delete;
@@ -23,14 +37,74 @@ public:
 
     static auto instance() -> Worker *;
 
-public Q_SLOTS:
-    void processDriveImageRequest(int, const QString &);
-    void processMemoryImageRequest(int, const QByteArray &);
-    void processImageResize(const QImage &image, const QSize &size, int number);
+    // set to true by the requester when the result is no longer wanted
+    using Token = std::shared_ptr<std::atomic_bool>;
+
+    void start(int threadCount);
+    void stop();
+    void setThreadCount(int threadCount);
+    auto requestDriveImage(int generation, int number, const QString &path, const QSize &size) -> Token;
+    auto requestMemoryImage(int generation, int number, const QString &archiveFile,
+                            const QString &entry, const QSize &size) -> Token;
+    auto requestImageData(int generation, int number, const QByteArray &data, const QSize &size) -> Token;
+    auto requestResize(int generation, int number, const QImage &image, const QSize &size) -> Token;
+    void setVisibleRange(int first, int last);
+    void setResizeFilter(Resampler::Filter filter);
+    void setDetectGrayscale(bool detect);
 
 Q_SIGNALS:
-    void imageReady(const QImage &image, int number);
-    void imageResized(const QImage &image, int number);
+    // data holds the encoded file, so the page can be decoded again without reading it
+    void imageReady(const QImage &image, const QByteArray &data, const QSize &size, int number, int generation);
+    void imageResized(const QImage &image, const QSize &size, int number, int generation);
+
+private:
+    enum class Job {
+        LoadFromDrive,
+        LoadFromMemory,
+        LoadFromData,
+        Resize
+    };
+
+    struct Request {
+        Job job{Job::LoadFromDrive};
+        int number{-1};
+        int generation{0};
+        quint64 sequence{0};
+        Token token;
+        QString path;
+        QString entry;
+        QByteArray data;
+        QImage image;
+        // the size the page is displayed at, images are decoded close to it when possible
+        QSize size;
+        // entries of the requests for the same archive that are taken next, read ahead meanwhile
+        QStringList upcoming;
+    };
+
+    auto enqueue(Request request) -> Token;
+    auto takeRequest(Request &request) -> bool;
+    auto distance(int number) const -> int;
+    auto isBefore(const Request &a, const Request &b) const -> bool;
+    void run();
+    void processImageRequest(const Request &request, std::unique_ptr<KArchive> &archive);
+    void processImageResize(const Request &request);
+    static auto readImage(QImageReader &reader, const QSize &displaySize) -> QImage;
+    static auto readArchiveEntry(std::unique_ptr<KArchive> &archive,
+                                 const QString &archiveFile,
+                                 const QString &entry,
+                                 const QStringList &upcoming,
+                                 bool *mapped) -> QByteArray;
+
+    QMutex               m_mutex;
+    QWaitCondition       m_condition;
+    std::vector<Request> m_queue;
+    QList<QThread *>     m_threads;
+    quint64              m_sequence{0};
+    int                  m_firstVisible{-1};
+    int                  m_lastVisible{-1};
+    bool                 m_quit{false};
+    std::atomic<Resampler::Filter> m_resizeFilter{Resampler::Filter::Bilinear};
+    std::atomic_bool m_detectGrayscale{true};
 };
 
 #endif // WORKER_H
@@ -0,0 +1,456 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "zipreader.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QFile>
+#include <QtEndian>
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+#include <KLocalizedString>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+constexpr quint32 LocalHeaderSignature = 0x04034b50;
+constexpr quint32 CentralHeaderSignature = 0x02014b50;
+constexpr quint32 EndSignature = 0x06054b50;
+constexpr quint32 Zip64EndSignature = 0x06064b50;
+constexpr quint32 Zip64LocatorSignature = 0x07064b50;
+constexpr int LocalHeaderSize = 30;
+constexpr int CentralHeaderSize = 46;
+constexpr int EndSize = 22;
+constexpr int Zip64EndSize = 56;
+constexpr int Zip64LocatorSize = 20;
+constexpr quint16 Zip64ExtraField = 0x0001;
+constexpr quint16 Stored = 0;
+constexpr quint16 Deflated = 8;
+// deflate can't expand more than this, a larger size in the header is a lie
+constexpr qint64 MaxDeflateRatio = 1032;
+// most that is hinted for reading ahead at once
+constexpr qint64 MaxReadahead = 64 * 1024 * 1024;
+
+template<typename T>
+auto read(const char *data) -> T
+{
+    return qFromLittleEndian<T>(reinterpret_cast<const uchar *>(data));
+}
+
+auto dosDateTime(quint16 date, quint16 time) -> QDateTime
+{
+    return {QDate(1980 + (date >> 9), (date >> 5) & 0xf, date & 0x1f),
+            QTime(time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2)};
+}
+
+class ZipReaderFile : public KArchiveFile
+{
+public:
+    ZipReaderFile(ZipReader *reader, const QString &name, int access, const QDateTime &date, qint64 index, qint64 size)
+        : KArchiveFile(reader, name, access, date, QString(), QString(), QString(), index, size)
+        , m_reader{reader}
+    {
+    }
+
+    auto data() const -> QByteArray override
+    {
+        return m_reader->entryData(position());
+    }
+
+    auto createDevice() const -> QIODevice * override
+    {
+        // stored entries of a mapped archive are read in place
+        QByteArray bytes = m_reader->entryView(position());
+        if (bytes.isEmpty()) {
+            bytes = data();
+        }
+        auto buffer = new QBuffer();
+        buffer->setData(bytes);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+
+private:
+    ZipReader *m_reader;
+};
+
+} // namespace
+
+ZipReader::ZipReader(const QString &fileName)
+    : KArchive(fileName)
+{
+}
+
+ZipReader::ZipReader(QIODevice *dev)
+    : KArchive(dev)
+{
+}
+
+ZipReader::~ZipReader()
+{
+    if (isOpen()) {
+        close();
+    }
+}
+
+auto ZipReader::fileNames() const -> const QStringList &
+{
+    return m_fileNames;
+}
+
+auto ZipReader::readCentralDirectory(qint64 *offset, qint64 *size, qint64 *count, qint64 *shift) -> bool
+{
+    // the end of central directory record is followed by a comment of at most 64 KiB
+    QIODevice *dev = device();
+    const qint64 fileSize = dev->size();
+    const qint64 tailSize = std::min<qint64>(fileSize, EndSize + 0xffff);
+    if (tailSize < EndSize || !dev->seek(fileSize - tailSize)) {
+        return false;
+    }
+    const QByteArray tail = dev->read(tailSize);
+    if (tail.size() != tailSize) {
+        return false;
+    }
+    qint64 end = tailSize - EndSize;
+    while (end >= 0 && read<quint32>(tail.constData() + end) != EndSignature) {
+        --end;
+    }
+    if (end < 0) {
+        return false;
+    }
+    const char *record = tail.constData() + end;
+    const qint64 endOffset = fileSize - tailSize + end;
+    *count = read<quint16>(record + 10);
+    *size = read<quint32>(record + 12);
+    *offset = read<quint32>(record + 16);
+
+    // zip64 keeps the real values in its own record, found through the locator before this one
+    if ((*count == 0xffff || *size == 0xffffffff || *offset == 0xffffffff) && end >= Zip64LocatorSize) {
+        const char *locator = record - Zip64LocatorSize;
+        if (read<quint32>(locator) == Zip64LocatorSignature) {
+            const auto zip64EndOffset = static_cast<qint64>(read<quint64>(locator + 8));
+            if (zip64EndOffset < 0 || !dev->seek(zip64EndOffset)) {
+                return false;
+            }
+            const QByteArray zip64End = dev->read(Zip64EndSize);
+            if (zip64End.size() != Zip64EndSize || read<quint32>(zip64End.constData()) != Zip64EndSignature) {
+                return false;
+            }
+            *count = static_cast<qint64>(read<quint64>(zip64End.constData() + 32));
+            *size = static_cast<qint64>(read<quint64>(zip64End.constData() + 40));
+            *offset = static_cast<qint64>(read<quint64>(zip64End.constData() + 48));
+            *shift = 0;
+            // read as 64 bit unsigned, large ones come out negative; the sum could overflow
+            return *count >= 0 && *offset >= 0 && *size >= 0
+                    && *offset <= zip64EndOffset && *size <= zip64EndOffset - *offset;
+        }
+    }
+
+    // data prepended to the archive (self extracting) shifts every offset
+    *shift = endOffset - *size - *offset;
+    if (*shift < 0) {
+        return false;
+    }
+    *offset += *shift;
+    return true;
+}
+
+auto ZipReader::openArchive(QIODevice::OpenMode mode) -> bool
+{
+    qint64 offset = 0;
+    qint64 size = 0;
+    qint64 count = 0;
+    qint64 shift = 0;
+    if (mode != QIODevice::ReadOnly || !readCentralDirectory(&offset, &size, &count, &shift)) {
+        setErrorString(i18n("Invalid zip file"));
+        return false;
+    }
+
+    // the whole central directory is read at once and parsed in one pass
+    QIODevice *dev = device();
+    const qint64 fileSize = dev->size();
+    if (!dev->seek(offset)) {
+        return false;
+    }
+    const QByteArray directory = dev->read(size);
+    if (directory.size() != size) {
+        setErrorString(i18n("Could not read the central directory"));
+        return false;
+    }
+    // count comes from the file, don't trust it more than the directory's size
+    count = std::min(count, size / CentralHeaderSize);
+    m_entries.clear();
+    m_entries.reserve(count);
+    m_fileNames.clear();
+    m_fileNames.reserve(count);
+
+    const char *data = directory.constData();
+    qint64 pos = 0;
+    while (pos + CentralHeaderSize <= size && read<quint32>(data + pos) == CentralHeaderSignature) {
+        const char *header = data + pos;
+        const quint16 flags = read<quint16>(header + 8);
+        const quint16 method = read<quint16>(header + 10);
+        const quint16 time = read<quint16>(header + 12);
+        const quint16 date = read<quint16>(header + 14);
+        qint64 compressedSize = read<quint32>(header + 20);
+        qint64 uncompressedSize = read<quint32>(header + 24);
+        const quint16 nameLength = read<quint16>(header + 28);
+        const quint16 extraLength = read<quint16>(header + 30);
+        const quint16 commentLength = read<quint16>(header + 32);
+        const quint32 externalAttributes = read<quint32>(header + 38);
+        qint64 headerOffset = read<quint32>(header + 42);
+        const qint64 next = pos + CentralHeaderSize + nameLength + extraLength + commentLength;
+        if (next > size) {
+            break;
+        }
+
+        // the zip64 extra field only has the values that didn't fit, in this order
+        const char *extra = header + CentralHeaderSize + nameLength;
+        const char *extraEnd = extra + extraLength;
+        while (extra + 4 <= extraEnd) {
+            const quint16 id = read<quint16>(extra);
+            const quint16 length = read<quint16>(extra + 2);
+            const char *field = extra + 4;
+            const char *fieldEnd = std::min(field + length, extraEnd);
+            if (id == Zip64ExtraField) {
+                if (uncompressedSize == 0xffffffff && field + 8 <= fieldEnd) {
+                    uncompressedSize = static_cast<qint64>(read<quint64>(field));
+                    field += 8;
+                }
+                if (compressedSize == 0xffffffff && field + 8 <= fieldEnd) {
+                    compressedSize = static_cast<qint64>(read<quint64>(field));
+                    field += 8;
+                }
+                if (headerOffset == 0xffffffff && field + 8 <= fieldEnd) {
+                    headerOffset = static_cast<qint64>(read<quint64>(field));
+                }
+                break;
+            }
+            extra += 4 + length;
+        }
+
+        // bit 11: utf-8 names
+        const QByteArray rawName(header + CentralHeaderSize, nameLength);
+        const QString name = (flags & 0x800) ? QString::fromUtf8(rawName) : QString::fromLocal8Bit(rawName);
+        // the zip64 values can be anything, an entry can't be larger than the file or start past its end
+        const bool valid = headerOffset >= 0 && compressedSize >= 0 && uncompressedSize >= 0
+                && headerOffset <= fileSize - shift && compressedSize <= fileSize;
+        if (valid && !name.endsWith(QLatin1Char('/'))) {
+            // anything else is left to KZip
+            if (method != Stored && method != Deflated) {
+                setErrorString(i18n("Unsupported compression method: %1", method));
+                return false;
+            }
+            const qint64 index = static_cast<qint64>(m_entries.size());
+            m_entries.push_back({headerOffset + shift, compressedSize, uncompressedSize, method, (flags & 1) != 0});
+
+            const int slash = name.lastIndexOf(QLatin1Char('/'));
+            KArchiveDirectory *parent = slash < 0 ? rootDir() : findOrCreate(name.left(slash));
+            // unix permissions are in the high bits of the external attributes
+            const int access = (externalAttributes >> 16) ? static_cast<int>(externalAttributes >> 16) : 0100644;
+            auto file = new ZipReaderFile(this, name.mid(slash + 1), access, dosDateTime(date, time), index, uncompressedSize);
+            if (parent->addEntryV2(file)) {
+                m_fileNames.append(name);
+            } else {
+                delete file;
+            }
+        }
+        pos = next;
+    }
+
+    // a later entry can replace a file with a directory of the same name ("a" then "a/b"),
+    // or a file with another one; only names that find their file are listed
+    m_fileNames.removeDuplicates();
+    m_fileNames.removeIf([this](const QString &name) {
+        return !rootDir()->file(name);
+    });
+
+    // entries of archives opened from a file are read from a mapping of it
+    if (auto file = qobject_cast<QFile *>(dev)) {
+        m_mapSize = file->size();
+        m_map = m_mapSize > 0 ? file->map(0, m_mapSize) : nullptr;
+        if (!m_map) {
+            m_mapSize = 0;
+        }
+    }
+    return true;
+}
+
+auto ZipReader::closeArchive() -> bool
+{
+    if (m_map) {
+        if (auto file = qobject_cast<QFile *>(device())) {
+            file->unmap(m_map);
+        }
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+    m_entries.clear();
+    m_fileNames.clear();
+    return true;
+}
+
+auto ZipReader::entryData(qint64 index) -> QByteArray
+{
+    if (index < 0 || index >= static_cast<qint64>(m_entries.size())) {
+        return {};
+    }
+    const Entry &entry = m_entries[index];
+    if (entry.encrypted || entry.compressedSize < 0 || entry.size < 0
+            || entry.compressedSize > std::numeric_limits<uInt>::max() || entry.size > std::numeric_limits<uInt>::max()) {
+        return {};
+    }
+    const QByteArray raw = rawData(entry);
+    if (raw.size() != entry.compressedSize) {
+        return {};
+    }
+    if (entry.method == Stored) {
+        // copied out of the mapping, the caller may keep it after the archive is closed
+        QByteArray data = raw;
+        data.detach();
+        return data;
+    }
+
+    // the size comes from the header, it is allocated before inflating anything
+    if (entry.size > entry.compressedSize * MaxDeflateRatio + 1024) {
+        return {};
+    }
+    QByteArray data(entry.size, Qt::Uninitialized);
+    z_stream stream{};
+    // raw deflate, without zlib header
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return {};
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(raw.constData()));
+    stream.avail_in = static_cast<uInt>(raw.size());
+    stream.next_out = reinterpret_cast<Bytef *>(data.data());
+    stream.avail_out = static_cast<uInt>(data.size());
+    const int result = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        return {};
+    }
+    data.truncate(static_cast<qsizetype>(stream.total_out));
+    return data;
+}
+
+auto ZipReader::entryView(qint64 index) -> QByteArray
+{
+    if (!m_map || index < 0 || index >= static_cast<qint64>(m_entries.size())) {
+        return {};
+    }
+    const Entry &entry = m_entries[index];
+    if (entry.encrypted || entry.method != Stored || entry.compressedSize < 0 || entry.compressedSize > m_mapSize) {
+        return {};
+    }
+    const QByteArray raw = rawData(entry);
+    return raw.size() == entry.compressedSize ? raw : QByteArray();
+}
+
+auto ZipReader::rawData(const Entry &entry) -> QByteArray
+{
+    // the local header's name and extra field can differ in length from the central directory's
+    if (m_map) {
+        // written as differences, offsets and sizes near the qint64 limits would overflow a sum
+        if (entry.headerOffset < 0 || entry.headerOffset > m_mapSize - LocalHeaderSize) {
+            return {};
+        }
+        const char *header = reinterpret_cast<const char *>(m_map) + entry.headerOffset;
+        if (read<quint32>(header) != LocalHeaderSignature) {
+            return {};
+        }
+        const qint64 dataOffset = entry.headerOffset + LocalHeaderSize + read<quint16>(header + 26) + read<quint16>(header + 28);
+        if (entry.compressedSize < 0 || dataOffset > m_mapSize || entry.compressedSize > m_mapSize - dataOffset) {
+            return {};
+        }
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(m_map) + dataOffset, entry.compressedSize);
+    }
+
+    QIODevice *dev = device();
+    if (!dev->seek(entry.headerOffset)) {
+        return {};
+    }
+    const QByteArray header = dev->read(LocalHeaderSize);
+    if (header.size() != LocalHeaderSize || read<quint32>(header.constData()) != LocalHeaderSignature) {
+        return {};
+    }
+    const qint64 dataOffset = entry.headerOffset + LocalHeaderSize
+            + read<quint16>(header.constData() + 26) + read<quint16>(header.constData() + 28);
+    if (!dev->seek(dataOffset)) {
+        return {};
+    }
+    return dev->read(entry.compressedSize);
+}
+
+void ZipReader::willNeed(const std::vector<qint64> &indexes)
+{
+#ifdef Q_OS_UNIX
+    // every entry's own range, the entries aren't necessarily stored in page order
+    if (!m_map) {
+        return;
+    }
+    static const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    qint64 total = 0;
+    for (qint64 index : indexes) {
+        if (index < 0 || index >= static_cast<qint64>(m_entries.size())) {
+            continue;
+        }
+        const Entry &entry = m_entries[index];
+        if (entry.headerOffset < 0 || entry.headerOffset >= m_mapSize || entry.compressedSize < 0) {
+            continue;
+        }
+        // the local header's name and extra field aren't known before it is read, up to 64 KiB each
+        const qint64 begin = entry.headerOffset;
+        const qint64 length = std::min(m_mapSize - begin, std::min(entry.compressedSize, m_mapSize)
+                                       + LocalHeaderSize + 0xffff + 0xffff);
+        total += length;
+        if (total > MaxReadahead) {
+            break;
+        }
+        const qint64 alignedBegin = begin - begin % pageSize;
+        madvise(m_map + alignedBegin, static_cast<size_t>(begin + length - alignedBegin), MADV_WILLNEED);
+    }
+#else
+    Q_UNUSED(indexes)
+#endif
+}
+
+// read only
+
+auto ZipReader::doWriteDir(const QString &, const QString &, const QString &,
+                           mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto ZipReader::doWriteSymLink(const QString &, const QString &, const QString &, const QString &,
+                               mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto ZipReader::doPrepareWriting(const QString &, const QString &, const QString &, qint64,
+                                 mode_t, const QDateTime &, const QDateTime &, const QDateTime &) -> bool
+{
+    return false;
+}
+
+auto ZipReader::doFinishWriting(qint64) -> bool
+{
+    return false;
+}
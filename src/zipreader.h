@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2019 George Florea Bănuș <georgefb899@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef ZIPREADER_H
+#define ZIPREADER_H
+
+#include <KArchive>
+
+#include <QStringList>
+
+#include <vector>
+
+// read only KArchive for zip files that only reads the central directory when opening,
+// KZip also reads the local header of every entry;
+// supports zip64 and the stored and deflated compression methods
+class ZipReader : public KArchive
+{
+public:
+    explicit ZipReader(const QString &fileName);
+    explicit ZipReader(QIODevice *dev);
+    ~ZipReader() override;
+
+    // paths of the files in the archive, in central directory order
+    auto fileNames() const -> const QStringList &;
+
+    // data of the entry at the given position, the index of its central directory record
+    auto entryData(qint64 index) -> QByteArray;
+    // data of a stored entry without copying it out of the mapped archive file,
+    // only valid while the archive is open; empty for compressed entries or when the file isn't mapped
+    auto entryView(qint64 index) -> QByteArray;
+    // asks the kernel to start reading the entries at these positions from the mapped file,
+    // the ones about to be read in the order they are needed
+    void willNeed(const std::vector<qint64> &indexes);
+
+protected:
+    auto openArchive(QIODevice::OpenMode mode) -> bool override;
+    auto closeArchive() -> bool override;
+    auto doWriteDir(const QString &name, const QString &user, const QString &group,
+                    mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doWriteSymLink(const QString &name, const QString &target, const QString &user, const QString &group,
+                        mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doPrepareWriting(const QString &name, const QString &user, const QString &group, qint64 size,
+                          mode_t perm, const QDateTime &atime, const QDateTime &mtime, const QDateTime &ctime) -> bool override;
+    auto doFinishWriting(qint64 size) -> bool override;
+
+private:
+    struct Entry {
+        qint64 headerOffset;
+        qint64 compressedSize;
+        qint64 size;
+        quint16 method;
+        bool encrypted;
+    };
+
+    auto readCentralDirectory(qint64 *offset, qint64 *size, qint64 *count, qint64 *shift) -> bool;
+    // the entry as it is stored in the file, pointing into the mapping when there is one
+    auto rawData(const Entry &entry) -> QByteArray;
+
+    std::vector<Entry> m_entries;
+    QStringList m_fileNames;
+    uchar *m_map{};
+    qint64 m_mapSize{0};
+};
+
+#endif // ZIPREADER_H